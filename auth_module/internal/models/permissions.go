@@ -37,11 +37,15 @@ const (
 	PermissionTestQuestAdd    Permission = "test:quest:add"
 	PermissionTestQuestUpdate Permission = "test:quest:update"
 	PermissionTestAnswerRead  Permission = "test:answer:read"
+	PermissionTestRegrade     Permission = "test:regrade"
 
 	// Answer permissions
 	PermissionAnswerRead   Permission = "answer:read"
 	PermissionAnswerUpdate Permission = "answer:update"
 	PermissionAnswerDel    Permission = "answer:del"
+
+	// Service permissions
+	PermissionDebugRead Permission = "debug:read"
 )
 
 // RolePermissions - разрешения для каждой роли
@@ -85,6 +89,8 @@ var RolePermissions = map[UserRole][]Permission{
 		PermissionQuestUpdate,
 		PermissionQuestCreate,
 		PermissionQuestDel,
+		PermissionTestRegrade,
+		PermissionDebugRead,
 	},
 }
 
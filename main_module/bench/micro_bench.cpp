@@ -0,0 +1,241 @@
+// Микробенчмарки горячих путей core без сети и базы.
+// Результаты в JSON: цель bench_json (micro_bench --benchmark_out=micro_bench.json).
+
+#include <benchmark/benchmark.h>
+#include "crow.h"
+#include "analytics/item_analysis.h"
+#include "db/pg_decode.h"
+#include "grading/grading.h"
+#include "middleware/rate_limit.h"
+#include "security/access.h"
+#include "security/jwt.h"
+#include "stream/answer_event.h"
+#include <jwt-cpp/jwt.h>
+#include <array>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* const kSecret = "micro-bench-secret";
+
+// Строка результата, как её отдал бы PQgetvalue
+struct CannedRow {
+    std::vector<std::string> cells;
+
+    const char* get(int column) const { return cells[column].c_str(); }
+};
+
+CannedRow questionRow() {
+    return {{
+        "1042", "3", "teacher-7f3a", "Сложность сортировки",
+        "Какова средняя сложность быстрой сортировки на случайных данных?",
+        R"json(["O(n)", "O(n log n)", "O(n^2)", "O(log n)"])json", "1", "f"
+    }};
+}
+
+std::string intArrayText(int n) {
+    std::string text = "{";
+    for (int i = 0; i < n; ++i) {
+        if (i) text += ",";
+        text += std::to_string(100000 + i);
+    }
+    return text + "}";
+}
+
+std::string userAnswersJson(int n) {
+    std::string text = "{";
+    for (int i = 0; i < n; ++i) {
+        if (i) text += ", ";
+        text += "\"" + std::to_string(100000 + i) + "\": " + std::to_string(i % 4);
+    }
+    return text + "}";
+}
+
+std::string signToken(const std::string& userId) {
+    return jwt::create()
+        .set_type("JWT")
+        .set_payload_claim("user_id", jwt::claim(userId))
+        .set_payload_claim("blocked", jwt::claim(picojson::value(false)))
+        .set_payload_claim("permissions", jwt::claim(picojson::array{
+            picojson::value(std::string("course:test:read")),
+            picojson::value(std::string("test:answer:read")),
+        }))
+        .set_expires_at(std::chrono::system_clock::now() + std::chrono::hours(1))
+        .sign(jwt::algorithm::hs256{kSecret});
+}
+
+crow::request requestWithToken(const std::string& token) {
+    crow::request req;
+    req.add_header("Authorization", "Bearer " + token);
+    return req;
+}
+
+} // namespace
+
+static void BM_DecodeQuestionRow(benchmark::State& state) {
+    CannedRow row = questionRow();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(decodeQuestion(row));
+    }
+}
+BENCHMARK(BM_DecodeQuestionRow);
+
+static void BM_DecodeTestRow(benchmark::State& state) {
+    CannedRow row{{"77", "12", "Итоговый тест", "t", "f"}};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(decodeTest(row));
+    }
+}
+BENCHMARK(BM_DecodeTestRow);
+
+static void BM_ParsePgIntArray(benchmark::State& state) {
+    std::string text = intArrayText((int)state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parsePgIntArray(text));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParsePgIntArray)->Arg(10)->Arg(50)->Arg(500);
+
+static void BM_QuestionToJson(benchmark::State& state) {
+    Question q = decodeQuestion(questionRow());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(q.to_json());
+    }
+}
+BENCHMARK(BM_QuestionToJson);
+
+// Тело PATCH /attempts/<id>/questions/<id>/answer
+static void BM_LoadAnswerBody(benchmark::State& state) {
+    std::string body = R"({"answer_index": 2})";
+    for (auto _ : state) {
+        auto json = crow::json::load(body);
+        benchmark::DoNotOptimize(json["answer_index"].i());
+    }
+}
+BENCHMARK(BM_LoadAnswerBody);
+
+// user_answers попытки, как их читает getTestAttemptDetails
+static void BM_LoadUserAnswers(benchmark::State& state) {
+    std::string body = userAnswersJson((int)state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(crow::json::load(body));
+    }
+    state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_LoadUserAnswers)->Arg(20)->Arg(200);
+
+// Оценка попытки: разбор user_answers в порядке ключа и подсчёт совпадений
+static void BM_GradeAttempt(benchmark::State& state) {
+    int n = (int)state.range(0);
+    AnswerKey key;
+    for (int i = 0; i < n; ++i) key.add(100000 + i, (i * 7) % 4);
+    std::string answers = userAnswersJson(n);
+    std::vector<int> scratch;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(gradeAttempt(key, answers, scratch));
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_GradeAttempt)->Arg(20)->Arg(200);
+
+// Кадр потока ответов, как его шлёт клиент после нескольких кликов
+static void BM_ParseAnswerEvent(benchmark::State& state) {
+    std::string frame = "{\"s\": 42, \"a\": [";
+    for (int i = 0; i < state.range(0); ++i) {
+        if (i) frame += ", ";
+        frame += "[" + std::to_string(100000 + i) + ", " + std::to_string(i % 4) + "]";
+    }
+    frame += "]}";
+    AnswerEvent event;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parseAnswerEvent(frame, event));
+    }
+    state.SetBytesProcessed(state.iterations() * frame.size());
+}
+BENCHMARK(BM_ParseAnswerEvent)->Arg(1)->Arg(20);
+
+// Статистика одного вопроса по столбцу ответов всех попыток теста
+static void BM_AnalyzeItem(benchmark::State& state) {
+    size_t n = (size_t)state.range(0);
+    std::vector<int8_t> chosen(n);
+    std::vector<uint8_t> correct(n);
+    std::vector<float> totals(n);
+    for (size_t i = 0; i < n; ++i) {
+        chosen[i] = (int8_t)((i * 7) % 5) - 1;
+        correct[i] = chosen[i] == 2;
+        totals[i] = (float)((i * 13) % 30);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(analyzeItem(chosen.data(), correct.data(), totals.data(), n));
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_AnalyzeItem)->Arg(1000)->Arg(100000);
+
+// Повторный токен: попадание в кеш проверенных токенов
+static void BM_VerifyJwtCached(benchmark::State& state) {
+    crow::request req = requestWithToken(signToken("student-1"));
+    parseAndVerifyJWT(req);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parseAndVerifyJWT(req));
+    }
+}
+BENCHMARK(BM_VerifyJwtCached);
+
+// Токенов больше, чем вмещает кеш: почти всегда HMAC и разбор payload
+static void BM_VerifyJwtUncached(benchmark::State& state) {
+    std::vector<crow::request> requests;
+    for (int i = 0; i < 20000; ++i) {
+        requests.push_back(requestWithToken(signToken("student-" + std::to_string(i))));
+    }
+    size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parseAndVerifyJWT(requests[next]));
+        next = (next + 1) % requests.size();
+    }
+}
+BENCHMARK(BM_VerifyJwtUncached);
+
+static void BM_CheckAccess(benchmark::State& state) {
+    UserContext ctx;
+    ctx.userId = "teacher-7f3a";
+    ctx.permissions = permissionBit("course:test:read") | permissionBit("test:answer:read");
+    PermissionRule granted{"test:answer:read", false, nullptr};
+    PermissionRule denied{"course:del", false, nullptr};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(checkAccess(ctx, granted, ""));
+        benchmark::DoNotOptimize(checkAccess(ctx, denied, ""));
+    }
+}
+BENCHMARK(BM_CheckAccess);
+
+// Проверка лимита на каждый запрос записи: выбор бюджета по URL и CAS в ведре
+static void BM_RateLimitTake(benchmark::State& state) {
+    TokenBuckets buckets;
+    RateBudget unlimited{"bench", 1000000000, 1000000};
+    std::vector<std::string> users;
+    for (int i = 0; i < 1000; ++i) users.push_back("student-" + std::to_string(i));
+    size_t next = 0;
+    for (auto _ : state) {
+        const RateBudget* budget = rateBudgetFor(crow::HTTPMethod::Patch, "/attempts/1042/questions/77/answer");
+        benchmark::DoNotOptimize(budget);
+        benchmark::DoNotOptimize(buckets.tryTake(TokenBuckets::key(users[next], unlimited), unlimited,
+                                                 std::chrono::steady_clock::now()));
+        next = (next + 1) % users.size();
+    }
+}
+BENCHMARK(BM_RateLimitTake)->Threads(1)->Threads(8);
+
+int main(int argc, char** argv) {
+    setenv("JWT_SECRET_KEY", kSecret, 1);
+    if (!initJWT()) return 1;
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
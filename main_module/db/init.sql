@@ -12,6 +12,7 @@ CREATE TABLE IF NOT EXISTS course_students (
     user_id                 TEXT NOT NULL,
     PRIMARY KEY (course_id, user_id)
 );
+CREATE INDEX IF NOT EXISTS idx_course_students_user ON course_students (user_id);
 
 CREATE SEQUENCE IF NOT EXISTS questions_id_seq;
 
@@ -27,6 +28,7 @@ CREATE TABLE IF NOT EXISTS questions (
     is_deleted              BOOLEAN DEFAULT false,
     PRIMARY KEY (id, version)
 );
+CREATE INDEX IF NOT EXISTS idx_questions_author ON questions (author_id) WHERE is_deleted = false;
 
 -- Тесты
 CREATE TABLE IF NOT EXISTS tests (
@@ -38,6 +40,8 @@ CREATE TABLE IF NOT EXISTS tests (
     is_deleted              BOOLEAN DEFAULT FALSE,
     author_id               TEXT NOT NULL
 );
+CREATE INDEX IF NOT EXISTS idx_tests_course ON tests (course_id) WHERE is_deleted = false;
+CREATE INDEX IF NOT EXISTS idx_tests_question_ids ON tests USING GIN (question_ids);
 
 
 -- Попытки и ответы
@@ -52,6 +56,8 @@ CREATE TABLE IF NOT EXISTS test_attempts (
     created_at              TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
     UNIQUE(user_id, test_id)
 );
+CREATE INDEX IF NOT EXISTS idx_test_attempts_test_status ON test_attempts (test_id, status);
+CREATE INDEX IF NOT EXISTS idx_test_attempts_test_id ON test_attempts (test_id, id);
 
 
 -- Уведомления
@@ -65,3 +71,4 @@ CREATE TABLE IF NOT EXISTS notifications (
     is_sent_tg              BOOLEAN DEFAULT FALSE,
     created_at              TIMESTAMP WITH TIME ZONE DEFAULT CURRENT_TIMESTAMP
 );
+CREATE INDEX IF NOT EXISTS idx_notifications_unsent ON notifications (user_id) WHERE is_sent_tg = false;
@@ -0,0 +1,139 @@
+#include "item_analysis.h"
+#include "../http/json_writer.h"
+#include "../metrics/metrics.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+AnswerColumnsBuilder::AnswerColumnsBuilder(const AnswerKey& current, const std::unordered_map<int, int>& optionCounts) {
+    columns.questionIds = current.questionIds;
+    columns.correctOption = current.correct;
+    columns.optionCount.reserve(current.size());
+    for (int questionId : current.questionIds) {
+        auto it = optionCounts.find(questionId);
+        columns.optionCount.push_back(it == optionCounts.end() ? 0 : it->second);
+    }
+    columns.chosen.resize(current.size());
+    columns.correct.resize(current.size());
+}
+
+// Для каждого столбца - индекс вопроса в ключе снимка, -1 если вопроса в снимке нет
+const std::vector<int>& AnswerColumnsBuilder::positionsFor(const std::shared_ptr<const AnswerKey>& key) {
+    auto it = positions.find(key.get());
+    if (it != positions.end()) return it->second.second;
+
+    std::vector<int> mapping(columns.questionIds.size(), -1);
+    for (size_t j = 0; j < mapping.size(); ++j) {
+        auto p = key->position.find(columns.questionIds[j]);
+        if (p != key->position.end()) mapping[j] = p->second;
+    }
+    return positions.emplace(key.get(), std::make_pair(key, std::move(mapping))).first->second.second;
+}
+
+void AnswerColumnsBuilder::add(const std::shared_ptr<const AnswerKey>& key, std::string_view userAnswers, double score) {
+    const auto& mapping = positionsFor(key);
+    answersInKeyOrder(*key, userAnswers, scratch);
+
+    for (size_t j = 0; j < mapping.size(); ++j) {
+        int p = mapping[j];
+        int8_t chosen = AnswerColumns::kNotPresented;
+        uint8_t correct = 0;
+        if (p >= 0) {
+            int answer = scratch[p];
+            chosen = (answer >= 0 && answer <= std::numeric_limits<int8_t>::max())
+                ? (int8_t)answer : AnswerColumns::kNoAnswer;
+            correct = answer == key->correct[p];
+        }
+        columns.chosen[j].push_back(chosen);
+        columns.correct[j].push_back(correct);
+    }
+    columns.totals.push_back((float)score);
+}
+
+ItemStats analyzeItem(const int8_t* chosen, const uint8_t* correct, const float* totals, size_t n) {
+    ItemStats stats;
+
+    // Суммы для корреляции Пирсона между x (верно, 0/1) и y (балл попытки)
+    // по попыткам, где вопрос был; x*x = x, поэтому сумма квадратов x не нужна
+    double count = 0, sx = 0, sy = 0, sxy = 0, syy = 0;
+    long long answered = 0;
+    for (size_t i = 0; i < n; ++i) {
+        double w = chosen[i] != AnswerColumns::kNotPresented;
+        double x = correct[i];
+        double y = totals[i];
+        count += w;
+        sx += x;
+        sy += w * y;
+        sxy += x * y;
+        syy += w * y * y;
+        answered += chosen[i] >= 0;
+    }
+
+    // Нет ответа и "не было вопроса" попадают в слоты 127 и 126 с нулевым вкладом
+    std::array<long long, 128> counts{};
+    for (size_t i = 0; i < n; ++i) {
+        int c = chosen[i];
+        counts[c & 0x7f] += c >= 0;
+    }
+    size_t used = counts.size();
+    while (used > 0 && counts[used - 1] == 0) --used;
+    stats.optionCounts.assign(counts.begin(), counts.begin() + used);
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    stats.presented = (long long)count;
+    stats.answered = answered;
+    stats.pValue = count > 0 ? sx / count : nan;
+
+    double cov = count * sxy - sx * sy;
+    double var = (count * sx - sx * sx) * (count * syy - sy * sy);
+    stats.discrimination = var > 0 ? cov / std::sqrt(var) : nan;
+    return stats;
+}
+
+std::string itemAnalysisJson(int testId, const AnswerColumns& columns) {
+    size_t n = columns.attempts();
+    double sum = 0;
+    for (float total : columns.totals) sum += total;
+
+    JsonWriter out;
+    out.beginObject()
+        .field("test_id", testId)
+        .field("attempts", (long long)n)
+        .field("mean_score", n > 0 ? sum / n : std::numeric_limits<double>::quiet_NaN())
+        .key("items").beginArray();
+
+    for (size_t j = 0; j < columns.questionIds.size(); ++j) {
+        auto stats = analyzeItem(columns.chosen[j].data(), columns.correct[j].data(), columns.totals.data(), n);
+        int correctOption = columns.correctOption[j];
+        size_t options = std::max({stats.optionCounts.size(), (size_t)columns.optionCount[j], (size_t)correctOption + 1});
+        stats.optionCounts.resize(options, 0);
+
+        out.beginObject()
+            .field("question_id", columns.questionIds[j])
+            .field("correct_option", correctOption)
+            .field("presented", stats.presented)
+            .field("answered", stats.answered)
+            .field("p_value", stats.pValue)
+            .field("discrimination", stats.discrimination)
+            .key("options").beginArray();
+        for (size_t k = 0; k < options; ++k) {
+            out.beginObject()
+                .field("index", (int)k)
+                .field("count", stats.optionCounts[k])
+                .field("share", stats.answered > 0 ? (double)stats.optionCounts[k] / stats.answered : 0.0)
+                .field("is_correct", (int)k == correctOption)
+                .endObject();
+        }
+        out.endArray().endObject();
+    }
+    out.endArray().endObject();
+    return out.str();
+}
+
+ItemAnalysisCache& itemAnalysisCache() {
+    static ItemAnalysisCache cache(1024, std::chrono::minutes(1));
+    static bool registered = (registerCacheMetrics("item_analysis", cache), true);
+    (void)registered;
+    return cache;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "../cache/ttl_cache.h"
+#include "../grading/grading.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Анализ заданий теста по завершённым попыткам: трудность (p-value),
+// различающая способность (точечно-бисериальная корреляция с баллом)
+// и частоты выбора вариантов.
+
+// Ответы теста по столбцам: у каждого вопроса свой непрерывный массив,
+// строка i во всех массивах - одна и та же попытка
+struct AnswerColumns {
+    static constexpr int8_t kNoAnswer = -1;
+    static constexpr int8_t kNotPresented = -2;  // вопроса не было в снимке попытки
+
+    std::vector<int> questionIds;                 // порядок теста
+    std::vector<int> correctOption;               // по текущим версиям вопросов
+    std::vector<int> optionCount;                 // 0 - неизвестно
+    std::vector<std::vector<int8_t>> chosen;      // выбранный вариант
+    std::vector<std::vector<uint8_t>> correct;    // 1 - верно по ключу снимка попытки
+    std::vector<float> totals;                    // балл попытки
+
+    size_t attempts() const { return totals.size(); }
+};
+
+// Раскладывает попытки по столбцам. Снимки попыток могут отличаться версиями
+// и составом вопросов, сопоставление столбцов считается один раз на ключ
+class AnswerColumnsBuilder {
+public:
+    AnswerColumnsBuilder(const AnswerKey& current, const std::unordered_map<int, int>& optionCounts);
+
+    void add(const std::shared_ptr<const AnswerKey>& key, std::string_view userAnswers, double score);
+    AnswerColumns finish() { return std::move(columns); }
+
+private:
+    const std::vector<int>& positionsFor(const std::shared_ptr<const AnswerKey>& key);
+
+    AnswerColumns columns;
+    std::unordered_map<const AnswerKey*, std::pair<std::shared_ptr<const AnswerKey>, std::vector<int>>> positions;
+    std::vector<int> scratch;
+};
+
+struct ItemStats {
+    int questionId = 0;
+    int correctOption = 0;
+    long long presented = 0;      // попыток, в которых был вопрос
+    long long answered = 0;
+    double pValue = 0;            // доля верных ответов среди presented
+    double discrimination = 0;    // NaN, если не определена (все ответили одинаково)
+    std::vector<long long> optionCounts;
+};
+
+// Простые циклы по столбцу без ветвлений в теле, компилятор их векторизует
+ItemStats analyzeItem(const int8_t* chosen, const uint8_t* correct, const float* totals, size_t n);
+
+// {"test_id", "attempts", "mean_score", "items": [{"question_id", "correct_option", "presented",
+//  "answered", "p_value", "discrimination", "options": [{"index", "count", "share", "is_correct"}]}]}
+std::string itemAnalysisJson(int testId, const AnswerColumns& columns);
+
+// Готовый JSON анализа по id теста, живёт минуту (метрики: item_analysis)
+using ItemAnalysisCache = TtlCache<int, std::shared_ptr<const std::string>>;
+ItemAnalysisCache& itemAnalysisCache();
@@ -0,0 +1,11 @@
+#pragma once
+#include "crow.h"
+#include "middleware/admission.h"
+#include "middleware/auth_middleware.h"
+#include "middleware/compression.h"
+#include "middleware/metrics_middleware.h"
+#include "middleware/rate_limit.h"
+
+// Приложение core со всеми глобальными middleware
+// Порядок важен: before_handle вызываются слева направо, after_handle - справа налево
+using CoreApp = crow::App<MetricsMiddleware, AdmissionMiddleware, CompressionMiddleware, AuthMiddleware, RateLimitMiddleware>;
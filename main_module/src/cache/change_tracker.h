@@ -0,0 +1,48 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Счётчики изменений сущностей для ETag.
+// DB увеличивает счётчик при каждой записи, обработчики сравнивают ETag до запроса в базу.
+// Счётчики лежат в фиксированной таблице: коллизия даёт лишний 200, но никогда не ложный 304.
+// Счётчики живут в процессе - при нескольких экземплярах core запись через другой
+// экземпляр сюда не попадёт, поэтому ETag включает эпоху процесса и подходит для одного экземпляра.
+enum class Entity : uint8_t {
+    CourseList,      // GET /courses
+    Course,          // GET /courses/<id>
+    CourseTests,     // GET /courses/<id>/tests
+    TestQuestions,   // GET /tests/<id>/question-ids
+    Question,        // GET /questions/<id>/<version>: is_deleted общий для всех версий
+};
+
+class ChangeTracker {
+public:
+    ChangeTracker()
+        : processEpoch(static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count())) {}
+
+    uint64_t version(Entity entity, int id = 0) const {
+        return slots[slot(entity, id)].load(std::memory_order_acquire);
+    }
+
+    void bump(Entity entity, int id = 0) {
+        slots[slot(entity, id)].fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    uint64_t epoch() const {
+        return processEpoch;
+    }
+
+private:
+    static constexpr size_t kSlots = 4096;
+
+    static size_t slot(Entity entity, int id) {
+        uint64_t key = (static_cast<uint64_t>(entity) << 32) | static_cast<uint32_t>(id);
+        key *= 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(key >> 52) % kSlots;
+    }
+
+    uint64_t processEpoch;
+    std::array<std::atomic<uint64_t>, kSlots> slots{};
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include "ttl_cache.h"
+#include "../db/db.h"
+#include "../metrics/metrics.h"
+#include "../grading/grading.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Готовые JSON-наборы вопросов для GET /attempts/<id>/bundle, по тексту снимка попытки.
+// Все попытки, начатые между изменениями теста, имеют один и тот же снимок,
+// поэтому в начале экзамена студенты получают одну строку без запросов в базу.
+// Набор собирается заранее при активации теста.
+class TestBundleCache {
+public:
+    explicit TestBundleCache(DB& db) : db(db), bundles(256, std::chrono::hours(24)) {
+        registerCacheMetrics("test_bundle", bundles);
+    }
+
+    std::shared_ptr<const std::string> get(const std::string& snapshot) {
+        if (!isPinnedSnapshot(snapshot)) {
+            return std::make_shared<const std::string>(db.getSnapshotBundle(snapshot));
+        }
+        if (auto body = bundles.get(snapshot)) return *body;
+
+        // Сборка одна на всех: остальные промахнувшиеся ждут её результат
+        std::lock_guard<std::mutex> lock(buildMutex);
+        // Повторная проверка без учёта в статистике промахов
+        if (auto body = bundles.getStale(snapshot, std::chrono::seconds(0))) return *body;
+        auto body = std::make_shared<const std::string>(db.getSnapshotBundle(snapshot));
+        bundles.put(snapshot, body);
+        return body;
+    }
+
+    // Собрать набор для попыток, которые начнутся сейчас (активация теста)
+    void build(int testId) {
+        std::string snapshot = db.getTestSnapshot(testId);
+        if (!snapshot.empty()) get(snapshot);
+    }
+
+private:
+    DB& db;
+    TtlCache<std::string, std::shared_ptr<const std::string>, StringKeyHash> bundles;
+    std::mutex buildMutex;
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Хеш для строковых ключей с поиском по string_view без аллокации
+struct StringKeyHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+// Ограниченный по размеру кеш с временем жизни записей.
+// Разбит на шарды, чтобы потоки Crow не упирались в один мьютекс.
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<>>
+class TtlCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TtlCache(size_t capacity, Clock::duration defaultTtl)
+        : shardCapacity(capacity / kShards + 1), defaultTtl(defaultTtl) {}
+
+    template <typename K>
+    std::optional<Value> get(const K& key) {
+        auto& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.items.find(key);
+        if (it == shard.items.end() || it->second.expiresAt <= Clock::now()) {
+            missCount.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        hitCount.fetch_add(1, std::memory_order_relaxed);
+        return it->second.value;
+    }
+
+    // Запись, протухшая не более чем на maxStale (для работы при недоступном источнике)
+    template <typename K>
+    std::optional<Value> getStale(const K& key, Clock::duration maxStale) {
+        auto& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.items.find(key);
+        if (it == shard.items.end() || it->second.expiresAt + maxStale <= Clock::now()) return std::nullopt;
+        return it->second.value;
+    }
+
+    void put(const Key& key, Value value) {
+        put(key, std::move(value), defaultTtl);
+    }
+
+    void put(const Key& key, Value value, Clock::duration ttl) {
+        auto& shard = shardFor(key);
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.items.size() >= shardCapacity && shard.items.find(key) == shard.items.end()) {
+            evict(shard, now);
+        }
+        shard.items.insert_or_assign(key, Entry{std::move(value), now + ttl});
+    }
+
+    template <typename K>
+    void erase(const K& key) {
+        auto& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.items.find(key);
+        if (it != shard.items.end()) shard.items.erase(it);
+    }
+
+    // Статистика get() для метрик (getStale не учитывается)
+    uint64_t hits() const { return hitCount.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return missCount.load(std::memory_order_relaxed); }
+
+    void clear() {
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.items.clear();
+        }
+    }
+
+private:
+    static constexpr size_t kShards = 16;
+
+    struct Entry {
+        Value value;
+        Clock::time_point expiresAt;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<Key, Entry, Hash, KeyEqual> items;
+    };
+
+    template <typename K>
+    Shard& shardFor(const K& key) {
+        return shards[Hash{}(key) % kShards];
+    }
+
+    // Сначала выбрасываем протухшие записи, если их нет - любую
+    void evict(Shard& shard, Clock::time_point now) {
+        for (auto it = shard.items.begin(); it != shard.items.end();) {
+            if (it->second.expiresAt <= now) it = shard.items.erase(it);
+            else ++it;
+        }
+        if (shard.items.size() >= shardCapacity) {
+            shard.items.erase(shard.items.begin());
+        }
+    }
+
+    std::array<Shard, kShards> shards;
+    size_t shardCapacity;
+    Clock::duration defaultTtl;
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> missCount{0};
+};
@@ -1,13 +1,21 @@
 #pragma once
 #include "crow.h"
+#include <functional>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include <libpq-fe.h>
 #include <stdexcept>
 #include <iostream>
 #include "../domain/test.h"
 #include "../domain/course.h"
 #include "../domain/question.h"
+#include "../cache/change_tracker.h"
+#include "../metrics/metrics.h"
+#include "../grading/grading.h"
+#include "../analytics/item_analysis.h"
+#include "../export/attempt_export.h"
+#include "query_stats.h"
 
 // Структура оценки пользователя
 struct UserScore {
@@ -15,6 +23,23 @@ struct UserScore {
     double score;
 };
 
+// Попытка для пересчёта баллов
+struct AttemptGradingRow {
+    int id = 0;
+    std::string status;
+    std::string snapshot;   // текст JSONB
+    std::string answers;    // текст JSONB
+    double score = 0.0;
+};
+
+// Итог завершения попытки
+enum class CompleteResult {
+    Completed,
+    NotInProgress,  // нет такой попытки или уже завершена
+    Conflict,       // ответы всё время менялись между чтением и записью - можно повторить
+    Error,          // ошибка базы или ключа ответов
+};
+
 // Структура информации о пользователе
 struct UserProfileData {
     std::vector<Course> courses;
@@ -27,10 +52,16 @@ public:
     DB(const std::string& conninfo);
     ~DB();
 
+    // Счётчики изменений для ETag
+    ChangeTracker& changes() { return changeTracker; }
+    // Статистика SQL-запросов (/debug/queries)
+    const QueryStats& queryStats() const { return queryStatistics; }
+
     // Тетсты
     Test getTestById(int testId);
     bool updateTestStatus(int testId, bool isActive);
-    void finalizeAllTestAttempts(int testId);
+    // false - часть попыток осталась in_progress (ошибка базы или ключа ответов)
+    bool finalizeAllTestAttempts(int testId);
     std::vector<Test> getTestsByCourseId(int courseId);
     int createTest(int courseId, const std::string& title, std::string authorId);
     bool deleteTest(int testId);
@@ -46,15 +77,48 @@ public:
     std::vector<int> getQuestionIdsByTestId(int testId);
     bool canAccessCourse(std::string userId, int courseId);
     int getCourseIdByTestId(int testId);
+    std::string getTestSnapshot(int testId);
+    std::string getSnapshotBundle(const std::string& snapshot);
 
     // Попытки
     int startTestAttempt(int testId, std::string userId);
     bool updateAttemptAnswer(int attemptId, int questionId, int answerIndex);
+    // Несколько ответов одним UPDATE, всё или ничего: попытка в процессе, принадлежит userId
+    // (или anyUser), все вопросы входят в снимок. batch: [{"question_id", "answer_index"}].
+    // Сохранённые ответы попытки (текст JSONB) или "", если ничего не записано
+    std::string saveAttemptAnswers(int attemptId, const std::string& userId, bool anyUser, const std::string& batch);
     bool isAttemptOwnedBy(int attemptId, std::string userId);
-    bool completeAttempt(int attemptId);
+    std::string getAttemptSnapshot(int attemptId, std::string userId);
+    CompleteResult completeAttempt(int attemptId);
+    // Ключ ответов снимка попытки (закреплённые снимки кешируются); nullptr при ошибке
+    std::shared_ptr<const AnswerKey> loadAnswerKey(const std::string& snapshot);
     crow::json::wvalue getAttemptData(int testId, std::string userId);
     crow::json::wvalue getAttemptAnswers(int testId, std::string userId);
 
+    // Пересчёт баллов (regrade)
+    std::vector<int> getTestIdsWithQuestion(int questionId);
+    std::unordered_map<int, int> getLatestVersions(const std::vector<int>& questionIds);
+    long long countAttempts(const std::vector<int>& testIds);
+    std::vector<AttemptGradingRow> getAttemptsChunk(int testId, int afterId, int limit);
+    std::vector<AttemptGradingRow> getAttemptsByIds(const std::vector<int>& attemptIds);
+    // batch: [{"id", "snapshot", "score", "graded", "old_snapshot", "old_status"}].
+    // Строка обновляется, только если снимок и статус не изменились с чтения; id обновлённых - в saved.
+    // Число обновлённых строк, -1 при ошибке
+    int saveRegradedAttempts(const std::string& batch, std::vector<int>& saved);
+
+    // Анализ заданий
+    // Число вариантов у последних версий вопросов: id -> count
+    std::unordered_map<int, int> getOptionCounts(const std::vector<int>& questionIds);
+    // Завершённые попытки теста по столбцам; столбцы - вопросы теста в текущем порядке
+    AnswerColumns getAnswerColumns(int testId);
+
+    // Выгрузка попыток теста: серверный курсор, порции по batchRows в одном снимке данных.
+    // Держит соединение на всё время выгрузки - вызывать на отдельном экземпляре DB.
+    // false при ошибке базы (часть порций уже могла быть передана)
+    bool streamTestAttempts(int testId, int batchRows,
+                            const std::function<void(const std::vector<AttemptExportRow>&)>& onBatch);
+    const std::string& connectionInfo() const { return conninfo; }
+
     // Курсы
     std::vector<Course> getCourses();
     Course getCourseById(int courseId);
@@ -76,7 +140,7 @@ public:
     bool hasUserAttemptForQuestion(std::string userId, int questionId);
 
     // Пользователь
-    crow::json::wvalue getUserDataProfile(std::string userId, bool includeCourses, bool includeTests, bool includeGrades);
+    std::string getUserDataProfile(std::string userId, bool includeCourses, bool includeTests, bool includeGrades);
 
     // Уведомления
     void markNotificationsAsSent(const std::vector<int>& ids, std::string userId);
@@ -90,6 +154,16 @@ public:
     );
 private:
     void ensureConnection();
+    // Замер времени вызова метода DB (core_db_call_duration_seconds{method})
+    ScopedTimer timeCall(const char* method);
+    // Выполнение SQL с учётом в статистике и журнале медленных запросов.
+    // method - имя метода DB (__func__), по нему запросы группируются в /debug/queries
+    PGresult* exec(const char* method, const char* sql, int nParams = 0, const char* const* params = nullptr);
+    void logSlowQuery(const char* method, const char* sql, int nParams, const char* const* params,
+                      std::chrono::nanoseconds elapsed, uint64_t rows, uint64_t bytes);
     void* conn;
     std::string conninfo;   
+    ChangeTracker changeTracker;
+    QueryLogOptions queryLog = QueryLogOptions::fromEnv();
+    QueryStats queryStatistics;
 };
@@ -1,14 +1,17 @@
 #include "db.h"
+#include "pg_decode.h"
 #include <iostream>
+#include <unordered_map>
 
 // Начать попытку
 int DB::startTestAttempt(int testId, std::string userId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
 
     const char* checkSql = "SELECT is_active, question_ids FROM tests WHERE id = $1::int AND is_deleted = false";
     std::string tId = std::to_string(testId);
     const char* tParams[] = { tId.c_str() };
-    PGresult* testRes = PQexecParams((PGconn*)conn, checkSql, 1, nullptr, tParams, nullptr, nullptr, 0);
+    PGresult* testRes = exec(__func__, checkSql, 1, tParams);
 
     if (PQresultStatus(testRes) != PGRES_TUPLES_OK || PQntuples(testRes) == 0) {
         PQclear(testRes);
@@ -18,17 +21,26 @@ int DB::startTestAttempt(int testId, std::string userId) {
     PQclear(testRes);
     if (!isActive) return -2;
 
+    // Снимок закрепляет последние версии вопросов в порядке теста: [{"id": 1, "version": 3}, ...]
     const char* createSql = 
         "INSERT INTO test_attempts (user_id, test_id, questions_snapshot, user_answers, status, score) "
-        "SELECT $1, $2::int, to_jsonb(question_ids), "
-        "       (SELECT jsonb_object_agg(q_id, -1) FROM unnest(question_ids) AS q_id), "
+        "SELECT $1, $2::int, s.snapshot, "
+        "       (SELECT jsonb_object_agg(q_id, -1) FROM unnest(t.question_ids) AS q_id), "
         "       'in_progress', 0.0 "
-        "FROM tests WHERE id = $2::int "
+        "FROM tests t "
+        "CROSS JOIN LATERAL ( "
+        "    SELECT COALESCE(jsonb_agg(jsonb_build_object('id', q.id, 'version', q.version) ORDER BY u.pos), '[]'::jsonb) AS snapshot "
+        "    FROM unnest(t.question_ids) WITH ORDINALITY AS u(question_id, pos) "
+        "    JOIN LATERAL ( "
+        "        SELECT id, version FROM questions WHERE id = u.question_id ORDER BY version DESC LIMIT 1 "
+        "    ) q ON true "
+        ") s "
+        "WHERE t.id = $2::int "
         "ON CONFLICT (user_id, test_id) DO NOTHING "
         "RETURNING id";
 
     const char* aParams[] = { userId.c_str(), tId.c_str() };
-    PGresult* res = PQexecParams((PGconn*)conn, createSql, 2, nullptr, aParams, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, createSql, 2, aParams);
     
     int attemptId = -1;
     if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
@@ -42,66 +54,71 @@ int DB::startTestAttempt(int testId, std::string userId) {
     return attemptId;
 }
 
-// Изменить значение ответа
+// Изменить значение ответа.
+// Балл здесь не считается: попытка оценивается целиком при завершении (completeAttempt)
 bool DB::updateAttemptAnswer(int attemptId, int questionId, int answerIndex) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     
     std::string attIdStr = std::to_string(attemptId);
     std::string qIdStr = std::to_string(questionId);
+    std::string ansIdxStr = std::to_string(answerIndex);
 
-    const char* existSql = "SELECT 1 FROM questions WHERE id = $1::int LIMIT 1";
-    const char* existParams[] = { qIdStr.c_str() };
-    PGresult* existRes = PQexecParams((PGconn*)conn, existSql, 1, nullptr, existParams, nullptr, nullptr, 0);
-    
-    if (PQresultStatus(existRes) != PGRES_TUPLES_OK || PQntuples(existRes) == 0) {
-        std::cerr << "Validation failed: Question ID " << questionId << " does not exist." << std::endl;
-        PQclear(existRes);
-        return false;
-    }
-    PQclear(existRes);
-    
-    const char* checkSql = 
-        "SELECT ta.user_answers->>$2::text, q.correct_option "
-        "FROM test_attempts ta "
-        "JOIN questions q ON q.id = $2::int "
-        "WHERE ta.id = $1::int";
-    
-    const char* params[] = { attIdStr.c_str(), qIdStr.c_str() };
-    PGresult* resCheck = PQexecParams((PGconn*)conn, checkSql, 2, nullptr, params, nullptr, nullptr, 0);
-
-    double scoreDelta = 0.0;
-
-    if (PQresultStatus(resCheck) == PGRES_TUPLES_OK && PQntuples(resCheck) > 0) {
-        std::string oldAnswer = PQgetvalue(resCheck, 0, 0);
-        int correctOption = std::stoi(PQgetvalue(resCheck, 0, 1));
-        
-        bool wasCorrect = (!oldAnswer.empty() && std::stoi(oldAnswer) == correctOption);
-        bool isNowCorrect = (answerIndex == correctOption);
-
-        if (!wasCorrect && isNowCorrect) scoreDelta = 1.0;
-        if (wasCorrect && !isNowCorrect) scoreDelta = -1.0;
-    }
-    PQclear(resCheck);
-
-    std::string updateSql = 
+    // Вопрос должен входить в снимок попытки (закреплённый или старый массив id)
+    const char* updateSql = 
         "UPDATE test_attempts "
-        "SET user_answers = user_answers || jsonb_build_object($2::text, $3::int), "
-        "    score = score + $4::float "
-        "WHERE id = $1::int AND status = 'in_progress'";
+        "SET user_answers = user_answers || jsonb_build_object($2::text, $3::int) "
+        "WHERE id = $1::int AND status = 'in_progress' "
+        "  AND (questions_snapshot @> jsonb_build_array(jsonb_build_object('id', $2::int)) "
+        "       OR questions_snapshot @> jsonb_build_array($2::int))";
 
-    std::string deltaStr = std::to_string(scoreDelta);
-    std::string ansIdxStr = std::to_string(answerIndex);
-    const char* updateParams[] = { attIdStr.c_str(), qIdStr.c_str(), ansIdxStr.c_str(), deltaStr.c_str() };
+    const char* updateParams[] = { attIdStr.c_str(), qIdStr.c_str(), ansIdxStr.c_str() };
 
-    PGresult* res = PQexecParams((PGconn*)conn, updateSql.c_str(), 4, nullptr, updateParams, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, updateSql, 3, updateParams);
     
     bool success = (PQresultStatus(res) == PGRES_COMMAND_OK && std::string(PQcmdTuples(res)) == "1");
     PQclear(res);
     return success;
 }
 
+std::string DB::saveAttemptAnswers(int attemptId, const std::string& userId, bool anyUser, const std::string& batch) {
+    auto timer = timeCall(__func__);
+    ensureConnection();
+
+    std::string attIdStr = std::to_string(attemptId);
+    const char* params[] = { attIdStr.c_str(), batch.c_str(), userId.c_str(), anyUser ? "true" : "false" };
+
+    // Проверка владельца, статуса и состава снимка - в том же запросе, что и запись
+    const char* sql =
+        "WITH batch AS ("
+        "    SELECT question_id, answer_index "
+        "    FROM jsonb_to_recordset($2::jsonb) AS a(question_id int, answer_index int)"
+        ") "
+        "UPDATE test_attempts ta "
+        "SET user_answers = ta.user_answers || "
+        "    (SELECT jsonb_object_agg(question_id::text, answer_index) FROM batch) "
+        "WHERE ta.id = $1::int AND ta.status = 'in_progress' "
+        "  AND (ta.user_id = $3 OR $4::boolean) "
+        "  AND NOT EXISTS ("
+        "      SELECT 1 FROM batch b "
+        "      WHERE NOT (ta.questions_snapshot @> jsonb_build_array(jsonb_build_object('id', b.question_id)) "
+        "                 OR ta.questions_snapshot @> jsonb_build_array(b.question_id))) "
+        "RETURNING ta.user_answers";
+
+    PGresult* res = exec(__func__, sql, 4, params);
+    std::string saved;
+    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+        if (PQntuples(res) == 1) saved = PQgetvalue(res, 0, 0);
+    } else {
+        std::cerr << "Save attempt answers failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+    }
+    PQclear(res);
+    return saved;
+}
+
 // Список пользователей прошедших тест
 std::vector<std::string> DB::getUsersWhoPassedTest(int testId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::string tId = std::to_string(testId);
     const char* params[] = { tId.c_str() };
@@ -110,7 +127,7 @@ std::vector<std::string> DB::getUsersWhoPassedTest(int testId) {
         "SELECT DISTINCT user_id FROM test_attempts "
         "WHERE test_id = $1::int AND status = 'completed'";
 
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 1, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql, 1, params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         std::cerr << "Get passed users failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
@@ -132,6 +149,7 @@ std::vector<std::string> DB::getUsersWhoPassedTest(int testId) {
 
 // Получить оценку пользователей (или себя)
 std::vector<UserScore> DB::getTestScores(int testId, std::string userIdFilter, bool isAuthor) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::string tId = std::to_string(testId);
     
@@ -143,7 +161,7 @@ std::vector<UserScore> DB::getTestScores(int testId, std::string userIdFilter, b
         params.push_back(userIdFilter.c_str());
     }
 
-    PGresult* res = PQexecParams((PGconn*)conn, sql.c_str(), (int)params.size(), nullptr, params.data(), nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql.c_str(), (int)params.size(), params.data());
     std::vector<UserScore> scores;
 
     if (PQresultStatus(res) == PGRES_TUPLES_OK) {
@@ -160,6 +178,7 @@ std::vector<UserScore> DB::getTestScores(int testId, std::string userIdFilter, b
 
 // Посмотреть ответы пользователей (пользователя)
 std::vector<AttemptDetails> DB::getTestAttemptDetails(int testId, std::string userIdFilter, bool isAuthor) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::string tId = std::to_string(testId);
     std::string sql = "SELECT user_id, user_answers FROM test_attempts WHERE test_id = $1::int";
@@ -170,7 +189,7 @@ std::vector<AttemptDetails> DB::getTestAttemptDetails(int testId, std::string us
         params.push_back(userIdFilter.c_str());
     }
 
-    PGresult* res = PQexecParams((PGconn*)conn, sql.c_str(), (int)params.size(), nullptr, params.data(), nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql.c_str(), (int)params.size(), params.data());
     std::vector<AttemptDetails> result;
 
     if (PQresultStatus(res) == PGRES_TUPLES_OK) {
@@ -199,35 +218,131 @@ std::vector<AttemptDetails> DB::getTestAttemptDetails(int testId, std::string us
 
 // Проверка на владение попыткой
 bool DB::isAttemptOwnedBy(int attemptId, std::string userId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     const char* sql = "SELECT 1 FROM test_attempts WHERE id = $1::int AND user_id = $2";
     std::string attId = std::to_string(attemptId);
     const char* params[] = { attId.c_str(), userId.c_str() };
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 2, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql, 2, params);
     bool owned = (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0);
     PQclear(res);
     return owned;
 }
 
-// Завершить попытку
-bool DB::completeAttempt(int attemptId) {
+// Снимок вопросов попытки (текст JSONB), если она принадлежит пользователю; пустая строка иначе
+std::string DB::getAttemptSnapshot(int attemptId, std::string userId) {
+    auto timer = timeCall(__func__);
+    ensureConnection();
+    const char* sql = "SELECT questions_snapshot FROM test_attempts WHERE id = $1::int AND user_id = $2";
+    std::string attId = std::to_string(attemptId);
+    const char* params[] = { attId.c_str(), userId.c_str() };
+    PGresult* res = exec(__func__, sql, 2, params);
+    std::string snapshot;
+    if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
+        snapshot = PQgetvalue(res, 0, 0);
+    }
+    PQclear(res);
+    return snapshot;
+}
+
+// Завершить попытку и оценить её по ключу снимка
+CompleteResult DB::completeAttempt(int attemptId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::string attId = std::to_string(attemptId);
     const char* params[] = { attId.c_str() };
-    const char* sql = "UPDATE test_attempts SET status = 'completed' WHERE id = $1::int AND status = 'in_progress'";
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 1, nullptr, params, nullptr, nullptr, 0);
-    bool success = (PQresultStatus(res) == PGRES_COMMAND_OK && std::string(PQcmdTuples(res)) == "1");
+
+    const char* readSql =
+        "SELECT questions_snapshot, user_answers FROM test_attempts "
+        "WHERE id = $1::int AND status = 'in_progress'";
+    // Ответ, записанный между чтением и обновлением, меняет user_answers - тогда оцениваем заново
+    const char* sql =
+        "UPDATE test_attempts SET status = 'completed', score = $2::float8 "
+        "WHERE id = $1::int AND status = 'in_progress' AND user_answers = $3::jsonb";
+
+    std::vector<int> scratch;
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        PGresult* readRes = exec(__func__, readSql, 1, params);
+        if (PQresultStatus(readRes) != PGRES_TUPLES_OK) {
+            std::cerr << "Complete attempt failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+            PQclear(readRes);
+            return CompleteResult::Error;
+        }
+        if (PQntuples(readRes) == 0) {
+            PQclear(readRes);
+            return CompleteResult::NotInProgress;
+        }
+        std::string snapshot = PQgetvalue(readRes, 0, 0);
+        std::string answers = PQgetvalue(readRes, 0, 1);
+        PQclear(readRes);
+
+        auto key = loadAnswerKey(snapshot);
+        if (!key) return CompleteResult::Error;
+
+        std::string score = std::to_string(gradeAttempt(*key, answers, scratch));
+        const char* updateParams[] = { attId.c_str(), score.c_str(), answers.c_str() };
+        PGresult* res = exec(__func__, sql, 3, updateParams);
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+            std::cerr << "Complete attempt failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+            PQclear(res);
+            return CompleteResult::Error;
+        }
+        bool success = std::string(PQcmdTuples(res)) == "1";
+        PQclear(res);
+        // Не совпало: либо пришёл новый ответ (перечитаем), либо попытку завершили параллельно
+        if (success) return CompleteResult::Completed;
+    }
+    // Попытка всё ещё в процессе, но ответы меняются быстрее, чем успеваем оценить
+    return CompleteResult::Conflict;
+}
+
+std::shared_ptr<const AnswerKey> DB::loadAnswerKey(const std::string& snapshot) {
+    auto timer = timeCall(__func__);
+    bool pinned = isPinnedSnapshot(snapshot);
+    if (pinned) {
+        if (auto cached = answerKeyCache().get(snapshot)) return *cached;
+    }
+    ensureConnection();
+
+    // Для старых снимков (массив id) - последние версии, как при показе
+    const char* sql =
+        "SELECT q.id, q.correct_option "
+        "FROM jsonb_array_elements($1::jsonb) WITH ORDINALITY AS e(item, pos) "
+        "JOIN LATERAL ("
+        "    SELECT id, correct_option FROM questions "
+        "    WHERE id = CASE WHEN jsonb_typeof(e.item) = 'object' THEN (e.item->>'id')::int "
+        "                    ELSE e.item::text::int END "
+        "      AND (jsonb_typeof(e.item) <> 'object' OR version = (e.item->>'version')::int) "
+        "    ORDER BY version DESC LIMIT 1"
+        ") q ON true "
+        "ORDER BY e.pos";
+
+    const char* params[] = { snapshot.c_str() };
+    PGresult* res = exec(__func__, sql, 1, params);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        std::cerr << "Load answer key failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+        PQclear(res);
+        return nullptr;
+    }
+
+    auto key = std::make_shared<AnswerKey>();
+    for (int i = 0; i < PQntuples(res); i++) {
+        key->add(parsePgInt(PQgetvalue(res, i, 0)), parsePgInt(PQgetvalue(res, i, 1)));
+    }
     PQclear(res);
-    return success;
+
+    if (pinned) answerKeyCache().put(snapshot, key);
+    return key;
 }
 
 // Посмотреть попытку
 crow::json::wvalue DB::getAttemptData(int testId, std::string userId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::string tId = std::to_string(testId);
     const char* params[] = { userId.c_str(), tId.c_str() };
     const char* sql = "SELECT status, user_answers, questions_snapshot FROM test_attempts WHERE user_id = $1 AND test_id = $2::int";
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 2, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql, 2, params);
 
     crow::json::wvalue result;
     if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
@@ -243,6 +358,7 @@ crow::json::wvalue DB::getAttemptData(int testId, std::string userId) {
 
 // Состояние ответов
 crow::json::wvalue DB::getAttemptAnswers(int testId, std::string userId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     
     std::string tId = std::to_string(testId);
@@ -252,7 +368,7 @@ crow::json::wvalue DB::getAttemptAnswers(int testId, std::string userId) {
         "SELECT status, user_answers "
         "FROM test_attempts WHERE user_id = $1 AND test_id = $2::int";
 
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 2, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql, 2, params);
 
     crow::json::wvalue result;
     if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
@@ -264,4 +380,259 @@ crow::json::wvalue DB::getAttemptAnswers(int testId, std::string userId) {
 
     PQclear(res);
     return result;
-}
\ No newline at end of file
+}
+
+// Массив int[] в текстовом виде для параметра: {1,2,3}
+static std::string toPgIntArray(const std::vector<int>& values) {
+    std::string text = "{";
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i) text += ',';
+        text += std::to_string(values[i]);
+    }
+    return text + "}";
+}
+
+// Тесты, в которые входит вопрос
+std::vector<int> DB::getTestIdsWithQuestion(int questionId) {
+    auto timer = timeCall(__func__);
+    ensureConnection();
+    std::string qId = std::to_string(questionId);
+    const char* params[] = { qId.c_str() };
+    const char* sql = "SELECT id FROM tests WHERE question_ids @> ARRAY[$1::int]";
+    PGresult* res = exec(__func__, sql, 1, params);
+    std::vector<int> ids;
+    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+        for (int i = 0; i < PQntuples(res); i++) {
+            ids.push_back(parsePgInt(PQgetvalue(res, i, 0)));
+        }
+    }
+    PQclear(res);
+    return ids;
+}
+
+// Последние версии вопросов: id -> version
+std::unordered_map<int, int> DB::getLatestVersions(const std::vector<int>& questionIds) {
+    auto timer = timeCall(__func__);
+    ensureConnection();
+    std::string ids = toPgIntArray(questionIds);
+    const char* params[] = { ids.c_str() };
+    const char* sql = "SELECT id, MAX(version) FROM questions WHERE id = ANY($1::int[]) GROUP BY id";
+    PGresult* res = exec(__func__, sql, 1, params);
+    std::unordered_map<int, int> versions;
+    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+        for (int i = 0; i < PQntuples(res); i++) {
+            versions[parsePgInt(PQgetvalue(res, i, 0))] = parsePgInt(PQgetvalue(res, i, 1));
+        }
+    }
+    PQclear(res);
+    return versions;
+}
+
+long long DB::countAttempts(const std::vector<int>& testIds) {
+    auto timer = timeCall(__func__);
+    ensureConnection();
+    std::string ids = toPgIntArray(testIds);
+    const char* params[] = { ids.c_str() };
+    const char* sql = "SELECT COUNT(*) FROM test_attempts WHERE test_id = ANY($1::int[])";
+    PGresult* res = exec(__func__, sql, 1, params);
+    long long count = 0;
+    if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
+        count = std::stoll(PQgetvalue(res, 0, 0));
+    }
+    PQclear(res);
+    return count;
+}
+
+// Очередная порция попыток теста по возрастанию id (keyset, без OFFSET)
+namespace {
+
+std::vector<AttemptGradingRow> readGradingRows(PGresult* res) {
+    std::vector<AttemptGradingRow> rows;
+    rows.reserve(PQntuples(res));
+    for (int i = 0; i < PQntuples(res); i++) {
+        rows.push_back({
+            parsePgInt(PQgetvalue(res, i, 0)),
+            PQgetvalue(res, i, 1),
+            PQgetvalue(res, i, 2),
+            PQgetvalue(res, i, 3),
+            std::stod(PQgetvalue(res, i, 4))
+        });
+    }
+    return rows;
+}
+
+} // namespace
+
+std::vector<AttemptGradingRow> DB::getAttemptsChunk(int testId, int afterId, int limit) {
+    auto timer = timeCall(__func__);
+    ensureConnection();
+    std::string tId = std::to_string(testId);
+    std::string after = std::to_string(afterId);
+    std::string lim = std::to_string(limit);
+    const char* params[] = { tId.c_str(), after.c_str(), lim.c_str() };
+    const char* sql =
+        "SELECT id, status, questions_snapshot, user_answers, COALESCE(score, 0) FROM test_attempts "
+        "WHERE test_id = $1::int AND id > $2::int "
+        "ORDER BY id LIMIT $3::int";
+    PGresult* res = exec(__func__, sql, 3, params);
+    std::vector<AttemptGradingRow> rows;
+    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+        rows = readGradingRows(res);
+    } else {
+        std::cerr << "Get attempts chunk failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+    }
+    PQclear(res);
+    return rows;
+}
+
+// Перечитать попытки, изменившиеся во время пересчёта
+std::vector<AttemptGradingRow> DB::getAttemptsByIds(const std::vector<int>& attemptIds) {
+    auto timer = timeCall(__func__);
+    ensureConnection();
+    std::string ids = toPgIntArray(attemptIds);
+    const char* params[] = { ids.c_str() };
+    const char* sql =
+        "SELECT id, status, questions_snapshot, user_answers, COALESCE(score, 0) FROM test_attempts "
+        "WHERE id = ANY($1::int[]) ORDER BY id";
+    PGresult* res = exec(__func__, sql, 1, params);
+    std::vector<AttemptGradingRow> rows;
+    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+        rows = readGradingRows(res);
+    } else {
+        std::cerr << "Get attempts by ids failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+    }
+    PQclear(res);
+    return rows;
+}
+
+// Снимок и статус сверяются с прочитанными: иначе попытку могли завершить по старому ключу,
+// и новый снимок разошёлся бы с её баллом
+int DB::saveRegradedAttempts(const std::string& batch, std::vector<int>& saved) {
+    auto timer = timeCall(__func__);
+    ensureConnection();
+    const char* params[] = { batch.c_str() };
+    const char* sql =
+        "UPDATE test_attempts ta "
+        "SET questions_snapshot = g.snapshot, "
+        "    score = CASE WHEN g.graded THEN g.score ELSE ta.score END "
+        "FROM jsonb_to_recordset($1::jsonb) AS g(id int, snapshot jsonb, score float8, graded boolean, "
+        "                                        old_snapshot jsonb, old_status text) "
+        "WHERE ta.id = g.id AND ta.questions_snapshot = g.old_snapshot AND ta.status = g.old_status "
+        "RETURNING ta.id";
+    PGresult* res = exec(__func__, sql, 1, params);
+    int updated = -1;
+    saved.clear();
+    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+        updated = PQntuples(res);
+        saved.reserve(updated);
+        for (int i = 0; i < updated; i++) saved.push_back(parsePgInt(PQgetvalue(res, i, 0)));
+    } else {
+        std::cerr << "Save regraded attempts failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+    }
+    PQclear(res);
+    return updated;
+}
+
+std::unordered_map<int, int> DB::getOptionCounts(const std::vector<int>& questionIds) {
+    auto timer = timeCall(__func__);
+    ensureConnection();
+    std::string ids = toPgIntArray(questionIds);
+    const char* params[] = { ids.c_str() };
+    const char* sql =
+        "SELECT DISTINCT ON (id) id, jsonb_array_length(options) FROM questions "
+        "WHERE id = ANY($1::int[]) ORDER BY id, version DESC";
+    PGresult* res = exec(__func__, sql, 1, params);
+    std::unordered_map<int, int> counts;
+    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+        for (int i = 0; i < PQntuples(res); i++) {
+            counts[parsePgInt(PQgetvalue(res, i, 0))] = parsePgInt(PQgetvalue(res, i, 1));
+        }
+    }
+    PQclear(res);
+    return counts;
+}
+
+// Попытки читаются порциями по id, в памяти остаются только столбцы
+AnswerColumns DB::getAnswerColumns(int testId) {
+    auto timer = timeCall(__func__);
+    constexpr int kChunkSize = 5000;
+
+    std::string snapshot = getTestSnapshot(testId);
+    if (snapshot.empty()) return {};
+    auto current = loadAnswerKey(snapshot);
+    if (!current) return {};
+
+    AnswerColumnsBuilder builder(*current, getOptionCounts(current->questionIds));
+    std::unordered_map<std::string, std::shared_ptr<const AnswerKey>> keys;
+    int afterId = 0;
+    while (true) {
+        auto chunk = getAttemptsChunk(testId, afterId, kChunkSize);
+        for (const auto& row : chunk) {
+            if (row.status != "completed") continue;
+            auto it = keys.find(row.snapshot);
+            if (it == keys.end()) it = keys.emplace(row.snapshot, loadAnswerKey(row.snapshot)).first;
+            if (it->second) builder.add(it->second, row.answers, row.score);
+        }
+        if ((int)chunk.size() < kChunkSize) break;
+        afterId = chunk.back().id;
+    }
+    return builder.finish();
+}
+
+bool DB::streamTestAttempts(int testId, int batchRows,
+                            const std::function<void(const std::vector<AttemptExportRow>&)>& onBatch) {
+    auto timer = timeCall(__func__);
+    ensureConnection();
+
+    auto command = [&](const char* sql, int nParams = 0, const char* const* params = nullptr) {
+        PGresult* res = exec(__func__, sql, nParams, params);
+        bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        if (!ok) std::cerr << "Export attempts failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+        PQclear(res);
+        return ok;
+    };
+
+    const char* select =
+        "SELECT id, user_id, status, COALESCE(score, 0), user_answers FROM test_attempts "
+        "WHERE test_id = $1::int ORDER BY id";
+    std::string declare = std::string("DECLARE attempt_export NO SCROLL CURSOR FOR ") + select;
+    std::string fetch = "FETCH FORWARD " + std::to_string(batchRows) + " FROM attempt_export";
+    std::string tId = std::to_string(testId);
+    const char* params[] = { tId.c_str() };
+
+    if (!command("BEGIN ISOLATION LEVEL REPEATABLE READ READ ONLY")) return false;
+    if (!command(declare.c_str(), 1, params)) {
+        command("ROLLBACK");
+        return false;
+    }
+
+    std::vector<AttemptExportRow> rows;
+    bool success = true;
+    while (true) {
+        PGresult* res = exec(__func__, fetch.c_str());
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            std::cerr << "Export attempts failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+            PQclear(res);
+            success = false;
+            break;
+        }
+        int count = PQntuples(res);
+        rows.clear();
+        rows.reserve(count);
+        for (int i = 0; i < count; i++) {
+            rows.push_back({
+                parsePgInt(PQgetvalue(res, i, 0)),
+                PQgetvalue(res, i, 1),
+                PQgetvalue(res, i, 2),
+                std::stod(PQgetvalue(res, i, 3)),
+                PQgetvalue(res, i, 4)
+            });
+        }
+        PQclear(res);
+        if (count > 0) onBatch(rows);
+        if (count < batchRows) break;
+    }
+
+    command(success ? "COMMIT" : "ROLLBACK");
+    return success;
+}
@@ -1,4 +1,10 @@
 #include "db.h"
+#include "../http/json_writer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <string_view>
+#include <unordered_map>
 
 // Конструктор
 DB::DB(const std::string& conninfo) : conninfo(conninfo), conn(nullptr) {
@@ -25,4 +31,97 @@ void DB::ensureConnection() {
             std::cout << "Successfully connected to DB" << std::endl;
         }
     }
-}
\ No newline at end of file
+}
+
+// __func__ у каждого метода - своя строка со статическим адресом, по нему и кешируем серию
+ScopedTimer DB::timeCall(const char* method) {
+    thread_local std::unordered_map<const char*, Histogram*> cache;
+    auto it = cache.find(method);
+    if (it == cache.end()) {
+        auto& histogram = MetricsRegistry::instance().histogram(
+            "core_db_call_duration_seconds", "DB method latency", {{"method", method}});
+        it = cache.emplace(method, &histogram).first;
+    }
+    return ScopedTimer(it->second);
+}
+
+PGresult* DB::exec(const char* method, const char* sql, int nParams, const char* const* params) {
+    static Gauge& inFlight = MetricsRegistry::instance().gauge(
+        "core_db_queries_in_flight", "SQL statements currently executing");
+
+    inFlight.add(1);
+    auto start = std::chrono::steady_clock::now();
+    PGresult* res = PQexecParams((PGconn*)conn, sql, nParams, nullptr, params, nullptr, nullptr, 0);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    inFlight.add(-1);
+
+    auto status = PQresultStatus(res);
+    uint64_t rows = 0;
+    uint64_t bytes = 0;
+    if (status == PGRES_TUPLES_OK) {
+        rows = PQntuples(res);
+        int fields = PQnfields(res);
+        for (int i = 0; i < (int)rows; i++) {
+            for (int j = 0; j < fields; j++) {
+                bytes += PQgetlength(res, i, j);
+            }
+        }
+    } else if (status == PGRES_COMMAND_OK) {
+        rows = std::strtoull(PQcmdTuples(res), nullptr, 10);
+    }
+
+    bool ok = status == PGRES_TUPLES_OK || status == PGRES_COMMAND_OK;
+    queryStatistics.record(method, sql, elapsed, rows, bytes, ok);
+
+    if (queryLog.slowThreshold.count() > 0 && elapsed >= queryLog.slowThreshold) {
+        logSlowQuery(method, sql, nParams, params, elapsed, rows, bytes);
+    }
+    return res;
+}
+
+// Одна JSON-строка в stderr на медленный запрос
+void DB::logSlowQuery(const char* method, const char* sql, int nParams, const char* const* params,
+                      std::chrono::nanoseconds elapsed, uint64_t rows, uint64_t bytes) {
+    JsonWriter out;
+    out.beginObject()
+        .field("event", "slow_query")
+        .field("method", method)
+        .field("ms", std::chrono::duration<double, std::milli>(elapsed).count())
+        .field("rows", rows)
+        .field("bytes", bytes)
+        .field("sql", sql)
+        .key("params").beginArray();
+    for (int i = 0; i < nParams; i++) {
+        out.value(redactParam(params[i]));
+    }
+    out.endArray();
+
+    // EXPLAIN без ANALYZE: запрос повторно не выполняется, изменяющие тоже безопасны
+    std::string_view statement(sql);
+    statement.remove_prefix(std::min(statement.find_first_not_of(" \t\n"), statement.size()));
+    bool explainable = false;
+    for (std::string_view keyword : {"SELECT", "WITH", "INSERT", "UPDATE", "DELETE"}) {
+        if (statement.size() >= keyword.size() &&
+            std::equal(keyword.begin(), keyword.end(), statement.begin(),
+                       [](char a, char b) { return a == std::toupper((unsigned char)b); })) {
+            explainable = true;
+        }
+    }
+
+    if (queryLog.explain && explainable) {
+        std::string explainSql = std::string("EXPLAIN ") + sql;
+        PGresult* plan = PQexecParams((PGconn*)conn, explainSql.c_str(), nParams, nullptr, params, nullptr, nullptr, 0);
+        if (PQresultStatus(plan) == PGRES_TUPLES_OK) {
+            std::string text;
+            for (int i = 0; i < PQntuples(plan); i++) {
+                if (i) text += "\n";
+                text += PQgetvalue(plan, i, 0);
+            }
+            out.field("plan", text);
+        }
+        PQclear(plan);
+    }
+
+    out.endObject();
+    std::cerr << out.str() << std::endl;
+}
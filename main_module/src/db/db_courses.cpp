@@ -2,9 +2,10 @@
 
 // Получение всех курсов
 std::vector<Course> DB::getCourses() {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::vector<Course> courses;
-    PGresult* res = PQexec((PGconn*)conn, "SELECT id, title, description FROM courses WHERE is_deleted = false");
+    PGresult* res = exec(__func__, "SELECT id, title, description FROM courses WHERE is_deleted = false");
 
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         std::cerr << "SELECT failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
@@ -25,14 +26,15 @@ std::vector<Course> DB::getCourses() {
 
 // Получение курса по айди
 Course DB::getCourseById(int courseId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::string idStr = std::to_string(courseId);
     const char* paramValues[1] = { idStr.c_str() };
 
-    PGresult* res = PQexecParams(
-        (PGconn*)conn,
+    PGresult* res = exec(
+        __func__,
         "SELECT id, title, description, author_id, is_deleted FROM courses WHERE id = $1",
-        1, nullptr, paramValues, nullptr, nullptr, 0
+        1, paramValues
     );
 
     if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
@@ -53,6 +55,7 @@ Course DB::getCourseById(int courseId) {
 
 // Создание курса
 int DB::createCourse(const std::string& title, const std::string& description, std::string authorId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     const char* paramValues[3] = { 
         title.c_str(), 
@@ -60,16 +63,17 @@ int DB::createCourse(const std::string& title, const std::string& description, s
         authorId.c_str() 
     };
 
-    PGresult* res = PQexecParams(
-        (PGconn*)conn,
+    PGresult* res = exec(
+        __func__,
         "INSERT INTO courses(title, description, author_id) VALUES ($1, $2, $3) RETURNING id",
-        3, nullptr, paramValues, nullptr, nullptr, 0
+        3, paramValues
     );
 
     int newId = -1;
 
     if (PQresultStatus(res) == PGRES_TUPLES_OK) {
         newId = std::stoi(PQgetvalue(res, 0, 0));
+        changeTracker.bump(Entity::CourseList);
     } else {
         std::cerr << "Create course failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
     }
@@ -79,18 +83,23 @@ int DB::createCourse(const std::string& title, const std::string& description, s
 
 // Удаление курса (мягкое удаление)
 void DB::deleteCourse(int courseId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     
     std::string idStr = std::to_string(courseId);
     const char* paramValues[] = { idStr.c_str() };
-    PGresult* res = PQexecParams(
-        (PGconn*)conn,
+    PGresult* res = exec(
+        __func__,
         "UPDATE courses SET is_deleted = true WHERE id = $1",
-        1, nullptr, paramValues, nullptr, nullptr, 0
+        1, paramValues
     );
 
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         std::cerr << "Soft delete course failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+    } else {
+        changeTracker.bump(Entity::CourseList);
+        changeTracker.bump(Entity::Course, courseId);
+        changeTracker.bump(Entity::CourseTests, courseId);
     }
 
     PQclear(res);
@@ -98,6 +107,7 @@ void DB::deleteCourse(int courseId) {
 
 // Изменение информации о курсе
 bool DB::updateCourse(int courseId, std::string title, std::string description) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     
     std::string idStr = std::to_string(courseId);
@@ -107,16 +117,19 @@ bool DB::updateCourse(int courseId, std::string title, std::string description)
         idStr.c_str() 
     };
 
-    PGresult* res = PQexecParams(
-        (PGconn*)conn,
+    PGresult* res = exec(
+        __func__,
         "UPDATE courses SET title = $1, description = $2 WHERE id = $3 AND is_deleted = false",
-        3, nullptr, paramValues, nullptr, nullptr, 0
+        3, paramValues
     );
 
     bool success = (PQresultStatus(res) == PGRES_COMMAND_OK && std::string(PQcmdTuples(res)) == "1");
 
     if (!success) {
         std::cerr << "Update course failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+    } else {
+        changeTracker.bump(Entity::CourseList);
+        changeTracker.bump(Entity::Course, courseId);
     }
 
     PQclear(res);
@@ -125,6 +138,7 @@ bool DB::updateCourse(int courseId, std::string title, std::string description)
 
 // Добавление студента на курс
 bool DB::addStudentToCourse(int courseId, std::string userId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
 
     std::string cIdStr = std::to_string(courseId);
@@ -140,10 +154,10 @@ bool DB::addStudentToCourse(int courseId, std::string userId) {
         "WHERE EXISTS (SELECT 1 FROM courses WHERE id = $1::int AND is_deleted = false) "
         "ON CONFLICT (course_id, user_id) DO NOTHING";
 
-    PGresult* res = PQexecParams(
-        (PGconn*)conn,
+    PGresult* res = exec(
+        __func__,
         sql,
-        2, nullptr, paramValues, nullptr, nullptr, 0
+        2, paramValues
     );
     
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
@@ -160,6 +174,7 @@ bool DB::addStudentToCourse(int courseId, std::string userId) {
 
 // Удаление студента с курса
 bool DB::removeStudentFromCourse(int courseId, std::string userId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
 
     std::string cIdStr = std::to_string(courseId);
@@ -173,10 +188,10 @@ bool DB::removeStudentFromCourse(int courseId, std::string userId) {
         "DELETE FROM course_students "
         "WHERE course_id = $1 AND user_id = $2";
 
-    PGresult* res = PQexecParams(
-        (PGconn*)conn,
+    PGresult* res = exec(
+        __func__,
         sql,
-        2, nullptr, paramValues, nullptr, nullptr, 0
+        2, paramValues
     );
 
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
@@ -193,6 +208,7 @@ bool DB::removeStudentFromCourse(int courseId, std::string userId) {
 
 // Список всех студентов курса
 std::vector<std::string> DB::getStudentIdsByCourseId(int courseId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
 
     std::string cIdStr = std::to_string(courseId);
@@ -206,10 +222,10 @@ std::vector<std::string> DB::getStudentIdsByCourseId(int courseId) {
         "JOIN courses c ON cs.course_id = c.id "
         "WHERE c.id = $1 AND c.is_deleted = false";
 
-    PGresult* res = PQexecParams(
-        (PGconn*)conn,
+    PGresult* res = exec(
+        __func__,
         sql,
-        1, nullptr, paramValues, nullptr, nullptr, 0
+        1, paramValues
     );
 
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
@@ -9,6 +9,7 @@ void DB::pushNotification(
     const std::string& message, 
     const crow::json::wvalue& payload
 ) {
+    auto timer = timeCall(__func__);
     ensureConnection();
 
     std::string payloadStr = payload.dump();
@@ -25,15 +26,11 @@ void DB::pushNotification(
         "INSERT INTO notifications (user_id, type, title, message, payload) "
         "VALUES ($1, $2, $3, $4, $5::jsonb)";
 
-    PGresult* res = PQexecParams(
-        (PGconn*)conn,
+    PGresult* res = exec(
+        __func__,
         query,
         5,
-        NULL,
-        paramValues,
-        NULL,
-        NULL,
-        0 
+        paramValues
     );
 
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
@@ -44,6 +41,7 @@ void DB::pushNotification(
 }
 // Удалить уведомления (мягкое удаление)
 void DB::markNotificationsAsSent(const std::vector<int>& ids, std::string userId) {
+    auto timer = timeCall(__func__);
     if (ids.empty()) return;
 
     std::string pg_array = "{";
@@ -60,7 +58,7 @@ void DB::markNotificationsAsSent(const std::vector<int>& ids, std::string userId
 
     const char* sql = "UPDATE notifications SET is_sent_tg = TRUE WHERE id = ANY($1::int[]) AND user_id = $2";
 
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 2, nullptr, paramValues, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql, 2, paramValues);
 
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         CROW_LOG_ERROR << "DB Error (markNotificationsAsSent): " << PQerrorMessage((PGconn*)conn);
@@ -70,6 +68,7 @@ void DB::markNotificationsAsSent(const std::vector<int>& ids, std::string userId
 }
 // Получить список уведомлений
 std::vector<crow::json::wvalue> DB::getUnsentNotifications(std::string userId) {
+    auto timer = timeCall(__func__);
     std::vector<crow::json::wvalue> notifications;
     
     const char* paramValues[1];
@@ -78,7 +77,7 @@ std::vector<crow::json::wvalue> DB::getUnsentNotifications(std::string userId) {
     const char* sql = "SELECT id, type, title, message, payload FROM notifications "
                       "WHERE user_id = $1 AND is_sent_tg = FALSE";
 
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 1, nullptr, paramValues, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql, 1, paramValues);
 
     if (PQresultStatus(res) == PGRES_TUPLES_OK) {
         int rows = PQntuples(res);
@@ -1,8 +1,10 @@
 #include "db.h"
+#include "pg_decode.h"
 
 // Создание вопроса
 int DB::createQuestion(std::string authorId, const std::string& title, const std::string& content, 
                        const std::vector<std::string>& options, int correctOption) {
+    auto timer = timeCall(__func__);
     ensureConnection();
 
     crow::json::wvalue::list optList;
@@ -21,7 +23,7 @@ int DB::createQuestion(std::string authorId, const std::string& title, const std
     std::string cOpt = std::to_string(correctOption);
     const char* params[] = { aId.c_str(), title.c_str(), content.c_str(), optionsStr.c_str(), cOpt.c_str() };
 
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 5, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql, 5, params);
 
     int newId = -1;
     if (PQresultStatus(res) == PGRES_TUPLES_OK) {
@@ -33,22 +35,24 @@ int DB::createQuestion(std::string authorId, const std::string& title, const std
 
 // Удаление вопроса
 bool DB::deleteQuestion(int questionId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::string qIdStr = std::to_string(questionId);
     const char* params[] = { qIdStr.c_str() };
 
-    const char* checkSql = "SELECT 1 FROM test_questions WHERE question_id = $1 LIMIT 1";
-    PGresult* checkRes = PQexecParams((PGconn*)conn, checkSql, 1, nullptr, params, nullptr, nullptr, 0);
+    const char* checkSql = "SELECT 1 FROM tests WHERE question_ids @> ARRAY[$1::int] AND is_deleted = false LIMIT 1";
+    PGresult* checkRes = exec(__func__, checkSql, 1, params);
     bool isUsed = (PQntuples(checkRes) > 0);
     PQclear(checkRes);
 
     if (isUsed) return false; 
 
     const char* sql = "UPDATE questions SET is_deleted = true WHERE id = $1";
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 1, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql, 1, params);
     
     bool success = (PQresultStatus(res) == PGRES_COMMAND_OK);
     PQclear(res);
+    if (success) changeTracker.bump(Entity::Question, questionId);
     return success;
 }
 
@@ -56,12 +60,13 @@ bool DB::deleteQuestion(int questionId) {
 int DB::updateQuestion(int questionId, std::string userId, const std::string& title, 
                        const std::string& content, const std::vector<std::string>& options, 
                        int correctOption) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::string qId = std::to_string(questionId);
     const char* params[] = { qId.c_str() };
 
     const char* verSql = "SELECT MAX(version), author_id FROM questions WHERE id = $1 GROUP BY author_id";
-    PGresult* res = PQexecParams((PGconn*)conn, verSql, 1, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, verSql, 1, params);
 
     if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
         PQclear(res);
@@ -90,7 +95,7 @@ int DB::updateQuestion(int questionId, std::string userId, const std::string& ti
     const char* insParams[] = { qId.c_str(), newVer.c_str(), aId.c_str(), 
                                 title.c_str(), content.c_str(), optionsStr.c_str(), cOpt.c_str() };
 
-    PGresult* insRes = PQexecParams((PGconn*)conn, insertSql, 7, nullptr, insParams, nullptr, nullptr, 0);
+    PGresult* insRes = exec(__func__, insertSql, 7, insParams);
     
     int createdVersion = -1;
     if (PQresultStatus(insRes) == PGRES_TUPLES_OK) {
@@ -103,6 +108,7 @@ int DB::updateQuestion(int questionId, std::string userId, const std::string& ti
 
 // Получить детали вопроса
 Question DB::getQuestionByIdAndVersion(int questionId, int version) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::string qId = std::to_string(questionId);
     std::string ver = std::to_string(version);
@@ -112,23 +118,14 @@ Question DB::getQuestionByIdAndVersion(int questionId, int version) {
         "SELECT id, version, author_id, title, content, options, correct_option, is_deleted "
         "FROM questions WHERE id = $1::int AND version = $2::int";
 
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 2, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql, 2, params);
 
     if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
         PQclear(res);
         return {}; 
     }
 
-    Question q;
-    q.id = std::stoi(PQgetvalue(res, 0, 0));
-    q.version = std::stoi(PQgetvalue(res, 0, 1));
-    q.author_id = PQgetvalue(res, 0, 2);
-    q.title = PQgetvalue(res, 0, 3);
-    q.content = PQgetvalue(res, 0, 4);
-    auto optionsJson = crow::json::load(PQgetvalue(res, 0, 5));
-    if (optionsJson) for (auto& opt : optionsJson) q.options.push_back(opt.s());
-    q.correct_option = std::stoi(PQgetvalue(res, 0, 6));
-    q.is_deleted = (std::string(PQgetvalue(res, 0, 7)) == "t");
+    Question q = decodeQuestion(PgRow{res, 0});
 
     PQclear(res);
     return q;
@@ -136,6 +133,7 @@ Question DB::getQuestionByIdAndVersion(int questionId, int version) {
 
 // Получить список вопросов
 std::vector<Question> DB::getQuestionsList(std::string userId, bool canSeeAll) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     
     std::string sql = 
@@ -148,10 +146,10 @@ std::vector<Question> DB::getQuestionsList(std::string userId, bool canSeeAll) {
         sql += " AND author_id = $1";
         sql += " ORDER BY id, version DESC";
         const char* params[] = { userId.c_str() };
-        res = PQexecParams((PGconn*)conn, sql.c_str(), 1, nullptr, params, nullptr, nullptr, 0);
+        res = exec(__func__, sql.c_str(), 1, params);
     } else {
         sql += " ORDER BY id, version DESC";
-        res = PQexec((PGconn*)conn, sql.c_str());
+        res = exec(__func__, sql.c_str());
     }
     
 
@@ -175,6 +173,7 @@ std::vector<Question> DB::getQuestionsList(std::string userId, bool canSeeAll) {
 
 // Получить вопрос по айди
 Question DB::getQuestionById(int questionId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     
     std::string qIdStr = std::to_string(questionId);
@@ -186,10 +185,10 @@ Question DB::getQuestionById(int questionId) {
         "WHERE id = $1 "
         "ORDER BY version DESC LIMIT 1";
 
-    PGresult* res = PQexecParams(
-        (PGconn*)conn,
+    PGresult* res = exec(
+        __func__,
         sql,
-        1, nullptr, params, nullptr, nullptr, 0
+        1, params
     );
 
     if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
@@ -197,22 +196,7 @@ Question DB::getQuestionById(int questionId) {
         return {};
     }
 
-    Question q;
-    q.id = std::stoi(PQgetvalue(res, 0, 0));
-    q.version = std::stoi(PQgetvalue(res, 0, 1));
-    q.author_id = PQgetvalue(res, 0, 2);
-    q.title = PQgetvalue(res, 0, 3);
-    q.content = PQgetvalue(res, 0, 4);
-
-    auto optionsJson = crow::json::load(PQgetvalue(res, 0, 5));
-    if (optionsJson) {
-        for (auto& opt : optionsJson) {
-            q.options.push_back(opt.s());
-        }
-    }
-
-    q.correct_option = std::stoi(PQgetvalue(res, 0, 6));
-    q.is_deleted = (std::string(PQgetvalue(res, 0, 7)) == "t");
+    Question q = decodeQuestion(PgRow{res, 0});
 
     PQclear(res);
     return q;
@@ -220,6 +204,7 @@ Question DB::getQuestionById(int questionId) {
 
 // Была ли попытка пройти тест с конекретный вопросом
 bool DB::hasUserAttemptForQuestion(std::string userId, int questionId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::string uId = userId;
     std::string qId = std::to_string(questionId);
@@ -232,7 +217,7 @@ bool DB::hasUserAttemptForQuestion(std::string userId, int questionId) {
         "AND $2::int = ANY(t.question_ids) "
         "LIMIT 1";
 
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 2, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql, 2, params);
     bool exists = false;
     if (res && PQresultStatus(res) == PGRES_TUPLES_OK) {
         exists = (PQntuples(res) > 0);
@@ -1,7 +1,11 @@
 #include "db.h"
+#include "pg_decode.h"
+#include "../http/json_writer.h"
+#include <unordered_map>
 
 // Получение теста по айди
 Test DB::getTestById(int testId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     
     std::string idStr = std::to_string(testId);
@@ -9,10 +13,10 @@ Test DB::getTestById(int testId) {
 
     const char* sql = 
         "SELECT id, course_id, title, is_active, is_deleted FROM tests WHERE id = $1";
-    PGresult* res = PQexecParams(
-        (PGconn*)conn,
+    PGresult* res = exec(
+        __func__,
         sql,
-        1, nullptr, params, nullptr, nullptr, 0
+        1, params
     );
 
     if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
@@ -20,12 +24,7 @@ Test DB::getTestById(int testId) {
         return {0, 0, "", false, false}; 
     }
 
-    Test t;
-    t.id = std::stoi(PQgetvalue(res, 0, 0));
-    t.course_id = std::stoi(PQgetvalue(res, 0, 1));
-    t.title = PQgetvalue(res, 0, 2);
-    t.is_active = (std::string(PQgetvalue(res, 0, 3)) == "t");
-    t.is_deleted = (std::string(PQgetvalue(res, 0, 4)) == "t");
+    Test t = decodeTest(PgRow{res, 0});
 
     PQclear(res);
     return t;
@@ -33,6 +32,7 @@ Test DB::getTestById(int testId) {
 
 // Получение тестов по айди курса
 std::vector<Test> DB::getTestsByCourseId(int courseId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
 
     std::string cId = std::to_string(courseId);
@@ -41,10 +41,10 @@ std::vector<Test> DB::getTestsByCourseId(int courseId) {
     const char* sql = 
         "SELECT id, title FROM tests WHERE course_id = $1 AND is_deleted = false";
 
-    PGresult* res = PQexecParams(
-        (PGconn*)conn, 
+    PGresult* res = exec(
+        __func__,
         sql,
-        1, nullptr, params, nullptr, nullptr, 0
+        1, params
     );
 
     std::vector<Test> tests;
@@ -67,6 +67,7 @@ std::vector<Test> DB::getTestsByCourseId(int courseId) {
 
 // Создание теста (привязанного к курсу)
 int DB::createTest(int courseId, const std::string& title, std::string authorId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
 
     std::string cIdStr = std::to_string(courseId);
@@ -80,14 +81,15 @@ int DB::createTest(int courseId, const std::string& title, std::string authorId)
         "INSERT INTO tests (course_id, title, author_id) "
         "VALUES ($1, $2, $3) RETURNING id";
     
-    PGresult* res = PQexecParams(
-        (PGconn*)conn, 
-        sql, 
-        3, nullptr, paramValues, nullptr, nullptr, 0);
+    PGresult* res = exec(
+        __func__,
+        sql,
+        3, paramValues);
 
     int newId = -1;
     if (PQresultStatus(res) == PGRES_TUPLES_OK) {
         newId = std::stoi(PQgetvalue(res, 0, 0));
+        changeTracker.bump(Entity::CourseTests, courseId);
     } else {
         std::cerr << "Create test failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
     }
@@ -97,27 +99,33 @@ int DB::createTest(int courseId, const std::string& title, std::string authorId)
 
 // Удаление теста
 bool DB::deleteTest(int testId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
 
     std::string tIdStr = std::to_string(testId);
     const char* paramValues[] = { tIdStr.c_str() };
 
     const char* sql = 
-        "UPDATE tests SET is_deleted = true WHERE id = $1";
+        "UPDATE tests SET is_deleted = true WHERE id = $1 RETURNING course_id";
 
-    PGresult* res = PQexecParams(
-        (PGconn*)conn, 
-        sql, 
-        1, nullptr, paramValues, nullptr, nullptr, 0
+    PGresult* res = exec(
+        __func__,
+        sql,
+        1, paramValues
     );
 
-    bool success = (PQresultStatus(res) == PGRES_COMMAND_OK && std::string(PQcmdTuples(res)) == "1");
+    bool success = (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1);
+    if (success) {
+        changeTracker.bump(Entity::CourseTests, std::stoi(PQgetvalue(res, 0, 0)));
+        changeTracker.bump(Entity::TestQuestions, testId);
+    }
     PQclear(res);
     return success;
 }
 
 // Установка активности теста
 bool DB::updateTestStatus(int testId, bool isActive) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::string tId = std::to_string(testId);
     const char* status = isActive ? "true" : "false";
@@ -125,10 +133,10 @@ bool DB::updateTestStatus(int testId, bool isActive) {
 
     const char* sql = 
         "UPDATE tests SET is_active = $1 WHERE id = $2 AND is_deleted = false";
-    PGresult* res = PQexecParams(
-        (PGconn*)conn,
+    PGresult* res = exec(
+        __func__,
         sql,
-        2, nullptr, params, nullptr, nullptr, 0
+        2, params
     );
 
     bool success = (PQresultStatus(res) == PGRES_COMMAND_OK && std::string(PQcmdTuples(res)) == "1");
@@ -139,24 +147,97 @@ bool DB::updateTestStatus(int testId, bool isActive) {
     return success;
 }
 
-// Завершение всех попыток
-void DB::finalizeAllTestAttempts(int testId) {
+// Завершение всех попыток теста с оценкой каждой.
+// Попытки, для которых не удалось загрузить ключ ответов, остаются in_progress
+// (повторная деактивация или завершение студентом их доберут); false - завершены не все.
+// Запись ответов не смотрит на is_active, поэтому ответ может прийти между чтением и UPDATE:
+// такая попытка не совпадёт по user_answers, её перечитываем и оцениваем заново, как completeAttempt
+bool DB::finalizeAllTestAttempts(int testId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::string tId = std::to_string(testId);
     const char* params[] = { tId.c_str() };
 
-    const char* sql = 
-        "UPDATE test_attempts SET status = 'completed' "
-        "WHERE test_id = $1 AND status = 'in_progress'";
-    PQexecParams(
-        (PGconn*)conn,
-        sql,
-        1, nullptr, params, nullptr, nullptr, 0
-    );
+    const char* readSql =
+        "SELECT id, questions_snapshot, user_answers FROM test_attempts "
+        "WHERE test_id = $1::int AND status = 'in_progress'";
+    // Оценённые попытки теста одним UPDATE; балл действителен только для тех ответов, по которым считался
+    const char* sql =
+        "UPDATE test_attempts ta SET status = 'completed', score = g.score "
+        "FROM jsonb_to_recordset($2::jsonb) AS g(id int, score float8, answers jsonb) "
+        "WHERE ta.id = g.id AND ta.test_id = $1::int AND ta.status = 'in_progress' "
+        "AND ta.user_answers = g.answers";
+
+    // Снимков у теста обычно один-два: ключ грузится один раз на снимок
+    std::unordered_map<std::string, std::shared_ptr<const AnswerKey>> keys;
+    std::vector<int> scratch;
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        PGresult* readRes = exec(__func__, readSql, 1, params);
+        if (PQresultStatus(readRes) != PGRES_TUPLES_OK) {
+            std::cerr << "Finalize attempts failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+            PQclear(readRes);
+            return false;
+        }
+
+        JsonWriter batch;
+        batch.beginArray();
+        int graded = 0;
+        int skipped = 0;
+        int rows = PQntuples(readRes);
+        for (int i = 0; i < rows; i++) {
+            std::string snapshot = PQgetvalue(readRes, i, 1);
+            auto it = keys.find(snapshot);
+            if (it == keys.end()) it = keys.emplace(snapshot, loadAnswerKey(snapshot)).first;
+            if (!it->second) {
+                skipped++;
+                continue;
+            }
+            const char* answers = PQgetvalue(readRes, i, 2);
+            batch.beginObject()
+                .field("id", parsePgInt(PQgetvalue(readRes, i, 0)))
+                .field("score", gradeAttempt(*it->second, answers, scratch))
+                .key("answers").raw(answers)
+                .endObject();
+            graded++;
+        }
+        batch.endArray();
+        PQclear(readRes);
+
+        if (skipped > 0) {
+            std::cerr << "Finalize attempts of test " << testId << ": answer key unavailable, "
+                      << skipped << " attempt(s) left in progress" << std::endl;
+        }
+        if (graded == 0) return skipped == 0;
+
+        std::string body = batch.str();
+        const char* updateParams[] = { tId.c_str(), body.c_str() };
+        PGresult* res = exec(__func__, sql, 2, updateParams);
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+            std::cerr << "Finalize attempts failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+            PQclear(res);
+            return false;
+        }
+        int updated = std::atoi(PQcmdTuples(res));
+        PQclear(res);
+        if (skipped > 0) return false;
+        // Не совпали: ответ пришёл после чтения (перечитаем) или студент завершил попытку сам
+        if (updated == graded) return true;
+    }
+
+    // Ответы меняются быстрее, чем успеваем оценить: проверяем, что осталось
+    PGresult* readRes = exec(__func__, readSql, 1, params);
+    bool done = PQresultStatus(readRes) == PGRES_TUPLES_OK && PQntuples(readRes) == 0;
+    PQclear(readRes);
+    if (!done) {
+        std::cerr << "Finalize attempts of test " << testId << ": answers kept changing, "
+                  << "some attempts left in progress" << std::endl;
+    }
+    return done;
 }
 
 // Проверка записи на курс
 bool DB::isUserEnrolled(int courseId, std::string userId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
 
     std::string cId = std::to_string(courseId);
@@ -164,10 +245,10 @@ bool DB::isUserEnrolled(int courseId, std::string userId) {
 
     const char* sql = 
         "SELECT 1 FROM course_students WHERE course_id = $1 AND user_id = $2";
-    PGresult* res = PQexecParams(
-        (PGconn*)conn, 
+    PGresult* res = exec(
+        __func__,
         sql,
-        2, nullptr, params, nullptr, nullptr, 0
+        2, params
     );
     bool enrolled = (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0);
     PQclear(res);
@@ -176,13 +257,14 @@ bool DB::isUserEnrolled(int courseId, std::string userId) {
 
 // Удаление вопроса из теста
 bool DB::removeQuestionFromTest(int testId, int questionId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     std::string tId = std::to_string(testId);
     std::string qId = std::to_string(questionId);
     const char* tParams[] = { tId.c_str() };
 
     const char* checkSql = "SELECT 1 FROM test_attempts WHERE test_id = $1::int LIMIT 1";
-    PGresult* checkRes = PQexecParams((PGconn*)conn, checkSql, 1, nullptr, tParams, nullptr, nullptr, 0);
+    PGresult* checkRes = exec(__func__, checkSql, 1, tParams);
     
     if (PQresultStatus(checkRes) != PGRES_TUPLES_OK) {
         PQclear(checkRes);
@@ -202,15 +284,17 @@ bool DB::removeQuestionFromTest(int testId, int questionId) {
         "WHERE id = $1::int";
     
     const char* params[] = { tId.c_str(), qId.c_str() };
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 2, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql, 2, params);
     
     bool success = (PQresultStatus(res) == PGRES_COMMAND_OK);
+    if (success) changeTracker.bump(Entity::TestQuestions, testId);
     PQclear(res);
     return success;
 }
 
 // Добавление вопроса в тест
 bool DB::addQuestionToTest(int testId, int questionId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     
     std::string tId = std::to_string(testId);
@@ -218,7 +302,7 @@ bool DB::addQuestionToTest(int testId, int questionId) {
     const char* params[] = { tId.c_str() };
 
     const char* checkSql = "SELECT 1 FROM test_attempts WHERE test_id = $1::int LIMIT 1";
-    PGresult* checkRes = PQexecParams((PGconn*)conn, checkSql, 1, nullptr, params, nullptr, nullptr, 0);
+    PGresult* checkRes = exec(__func__, checkSql, 1, params);
 
     if (PQresultStatus(checkRes) != PGRES_TUPLES_OK) {
         std::cerr << "SQL Error (check): " << PQerrorMessage((PGconn*)conn) << std::endl;
@@ -239,9 +323,10 @@ bool DB::addQuestionToTest(int testId, int questionId) {
         "WHERE id = $1::int AND NOT ($2::int = ANY(question_ids))";
         
     const char* updateParams[] = { tId.c_str(), qId.c_str() };
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 2, nullptr, updateParams, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql, 2, updateParams);
 
     bool success = (PQresultStatus(res) == PGRES_COMMAND_OK);
+    if (success) changeTracker.bump(Entity::TestQuestions, testId);
     
     PQclear(res);
     return success;
@@ -249,13 +334,14 @@ bool DB::addQuestionToTest(int testId, int questionId) {
 
 // Изменение порядка вопросов в тесте
 bool DB::reorderQuestionsInTest(int testId, const std::vector<int>& questionIds) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     
     std::string tId = std::to_string(testId);
     const char* tParams[] = { tId.c_str() };
 
     const char* checkSql = "SELECT 1 FROM test_attempts WHERE test_id = $1::int LIMIT 1";
-    PGresult* checkRes = PQexecParams((PGconn*)conn, checkSql, 1, nullptr, tParams, nullptr, nullptr, 0);
+    PGresult* checkRes = exec(__func__, checkSql, 1, tParams);
     
     if (PQresultStatus(checkRes) != PGRES_TUPLES_OK) {
         PQclear(checkRes);
@@ -277,11 +363,13 @@ bool DB::reorderQuestionsInTest(int testId, const std::vector<int>& questionIds)
     const char* sql = "UPDATE tests SET question_ids = $1::int[] WHERE id = $2::int";
     const char* params[] = { arrayStr.c_str(), tId.c_str() };
     
-    PGresult* res = PQexecParams((PGconn*)conn, sql, 2, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql, 2, params);
     
     bool success = (PQresultStatus(res) == PGRES_COMMAND_OK);
     if (!success) {
         std::cerr << "Reorder failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+    } else {
+        changeTracker.bump(Entity::TestQuestions, testId);
     }
 
     PQclear(res);
@@ -290,6 +378,7 @@ bool DB::reorderQuestionsInTest(int testId, const std::vector<int>& questionIds)
 
 //  Получить список вопросов в тесте
 std::vector<int> DB::getQuestionIdsByTestId(int testId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     
     std::string sql = 
@@ -299,30 +388,87 @@ std::vector<int> DB::getQuestionIdsByTestId(int testId) {
     std::string testIdStr = std::to_string(testId);
     const char* params[] = { testIdStr.c_str() };
     
-    PGresult* res = PQexecParams((PGconn*)conn, sql.c_str(), 1, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql.c_str(), 1, params);
     
     std::vector<int> ids;
     
     if (res && PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
-        std::string arrayStr = PQgetvalue(res, 0, 0);
-        
-        if (arrayStr.size() > 2) {
-            arrayStr = arrayStr.substr(1, arrayStr.size() - 2);
-            
-            size_t pos = 0;
-            while ((pos = arrayStr.find(',')) != std::string::npos) {
-                std::string num = arrayStr.substr(0, pos);
-                if (!num.empty()) ids.push_back(std::stoi(num));
-                arrayStr.erase(0, pos + 1);
-            }
-            if (!arrayStr.empty()) ids.push_back(std::stoi(arrayStr));
-        }
+        ids = parsePgIntArray(PQgetvalue(res, 0, 0));
     }
     
     if (res) PQclear(res);
     return ids;
 }
+// Снимок, который получит попытка, начатая сейчас (текст JSONB)
+std::string DB::getTestSnapshot(int testId) {
+    auto timer = timeCall(__func__);
+    ensureConnection();
+    // Тот же снимок, что строит startTestAttempt
+    const char* sql =
+        "SELECT s.snapshot FROM tests t "
+        "CROSS JOIN LATERAL ( "
+        "    SELECT COALESCE(jsonb_agg(jsonb_build_object('id', q.id, 'version', q.version) ORDER BY u.pos), '[]'::jsonb) AS snapshot "
+        "    FROM unnest(t.question_ids) WITH ORDINALITY AS u(question_id, pos) "
+        "    JOIN LATERAL ( "
+        "        SELECT id, version FROM questions WHERE id = u.question_id ORDER BY version DESC LIMIT 1 "
+        "    ) q ON true "
+        ") s "
+        "WHERE t.id = $1::int AND t.is_deleted = false";
+    std::string testIdStr = std::to_string(testId);
+    const char* params[] = { testIdStr.c_str() };
+    PGresult* res = exec(__func__, sql, 1, params);
+    std::string snapshot;
+    if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
+        snapshot = PQgetvalue(res, 0, 0);
+    }
+    PQclear(res);
+    return snapshot;
+}
+
+// Вопросы снимка попытки в его порядке, без правильных ответов.
+// Готовый JSON: {"questions": [{"id", "version", "title", "content", "options"}]}.
+// Для старых снимков (массив id) берутся последние версии.
+std::string DB::getSnapshotBundle(const std::string& snapshot) {
+    auto timer = timeCall(__func__);
+    ensureConnection();
+
+    const char* sql =
+        "SELECT q.id, q.version, q.title, q.content, q.options "
+        "FROM jsonb_array_elements($1::jsonb) WITH ORDINALITY AS e(item, pos) "
+        "JOIN LATERAL ("
+        "    SELECT id, version, title, content, options FROM questions "
+        "    WHERE id = CASE WHEN jsonb_typeof(e.item) = 'object' THEN (e.item->>'id')::int "
+        "                    ELSE e.item::text::int END "
+        "      AND (jsonb_typeof(e.item) <> 'object' OR version = (e.item->>'version')::int) "
+        "    ORDER BY version DESC LIMIT 1"
+        ") q ON true "
+        "ORDER BY e.pos";
+
+    const char* params[] = { snapshot.c_str() };
+    PGresult* res = exec(__func__, sql, 1, params);
+
+    JsonWriter out;
+    out.beginObject().key("questions").beginArray();
+    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+        for (int i = 0; i < PQntuples(res); i++) {
+            out.beginObject()
+                .field("id", parsePgInt(PQgetvalue(res, i, 0)))
+                .field("version", parsePgInt(PQgetvalue(res, i, 1)))
+                .field("title", PQgetvalue(res, i, 2))
+                .field("content", PQgetvalue(res, i, 3))
+                .key("options").raw(PQgetvalue(res, i, 4))
+                .endObject();
+        }
+    } else {
+        std::cerr << "Get snapshot bundle failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
+    }
+    out.endArray().endObject();
+    PQclear(res);
+    return out.str();
+}
+
 bool DB::canAccessCourse(std::string userId, int courseId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     
     std::string sql = 
@@ -334,7 +480,7 @@ bool DB::canAccessCourse(std::string userId, int courseId) {
     std::string courseIdStr = std::to_string(courseId);
     const char* params[] = { userId.c_str(), courseIdStr.c_str() };
     
-    PGresult* res = PQexecParams((PGconn*)conn, sql.c_str(), 2, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql.c_str(), 2, params);
     
     bool canAccess = (res && PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0);
     
@@ -343,13 +489,14 @@ bool DB::canAccessCourse(std::string userId, int courseId) {
 }
 
 int DB::getCourseIdByTestId(int testId) {
+    auto timer = timeCall(__func__);
     ensureConnection();
     
     std::string sql = "SELECT course_id FROM tests WHERE id = $1 AND is_deleted = false";
     std::string testIdStr = std::to_string(testId);
     const char* params[] = { testIdStr.c_str() };
     
-    PGresult* res = PQexecParams((PGconn*)conn, sql.c_str(), 1, nullptr, params, nullptr, nullptr, 0);
+    PGresult* res = exec(__func__, sql.c_str(), 1, params);
     
     int courseId = -1;
     if (res && PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
@@ -1,9 +1,13 @@
 #include "db.h"
+#include "../http/json_writer.h"
 
-// Посмотреть информацию о пользователе (курсы, оценки, попытки)
-crow::json::wvalue DB::getUserDataProfile(std::string userId, bool includeCourses, bool includeTests, bool includeGrades) {
+// Посмотреть информацию о пользователе (курсы, оценки, попытки).
+// Возвращает готовый JSON: строки результата пишутся сразу в буфер ответа.
+std::string DB::getUserDataProfile(std::string userId, bool includeCourses, bool includeTests, bool includeGrades) {
+    auto timer = timeCall(__func__);
     ensureConnection();
-    crow::json::wvalue result;
+    JsonWriter out;
+    out.beginObject();
     std::string idStr = userId;
     const char* paramValues[1] = { idStr.c_str() };
 
@@ -14,16 +18,20 @@ crow::json::wvalue DB::getUserDataProfile(std::string userId, bool includeCourse
             "JOIN course_students cs ON c.id = cs.course_id "
             "WHERE cs.user_id = $1 AND c.is_deleted = false";
         
-        PGresult* res = PQexecParams((PGconn*)conn, sql, 1, nullptr, paramValues, nullptr, nullptr, 0);
+        PGresult* res = exec(__func__, sql, 1, paramValues);
+        out.key("courses").beginArray();
         if (PQresultStatus(res) == PGRES_TUPLES_OK) {
             for (int i = 0; i < PQntuples(res); i++) {
-                result["courses"][i]["id"] = std::stoi(PQgetvalue(res, i, 0));
-                result["courses"][i]["title"] = PQgetvalue(res, i, 1);
-                result["courses"][i]["description"] = PQgetvalue(res, i, 2);
+                out.beginObject()
+                    .field("id", std::stoi(PQgetvalue(res, i, 0)))
+                    .field("title", PQgetvalue(res, i, 1))
+                    .field("description", PQgetvalue(res, i, 2))
+                    .endObject();
             }
         } else {
             std::cerr << "Get user courses failed: " << PQerrorMessage((PGconn*)conn) << std::endl;
         }
+        out.endArray();
         PQclear(res);
     }
 
@@ -34,14 +42,18 @@ crow::json::wvalue DB::getUserDataProfile(std::string userId, bool includeCourse
             "JOIN course_students cs ON t.course_id = cs.course_id "
             "WHERE cs.user_id = $1 AND t.is_deleted = false AND t.is_active = true";
 
-        PGresult* res = PQexecParams((PGconn*)conn, sql, 1, nullptr, paramValues, nullptr, nullptr, 0);
+        PGresult* res = exec(__func__, sql, 1, paramValues);
+        out.key("tests").beginArray();
         if (PQresultStatus(res) == PGRES_TUPLES_OK) {
             for (int i = 0; i < PQntuples(res); i++) {
-                result["tests"][i]["id"] = std::stoi(PQgetvalue(res, i, 0));
-                result["tests"][i]["title"] = PQgetvalue(res, i, 1);
-                result["tests"][i]["course_id"] = std::stoi(PQgetvalue(res, i, 2));
+                out.beginObject()
+                    .field("id", std::stoi(PQgetvalue(res, i, 0)))
+                    .field("title", PQgetvalue(res, i, 1))
+                    .field("course_id", std::stoi(PQgetvalue(res, i, 2)))
+                    .endObject();
             }
         }
+        out.endArray();
         PQclear(res);
     }
 
@@ -52,17 +64,22 @@ crow::json::wvalue DB::getUserDataProfile(std::string userId, bool includeCourse
             "JOIN tests t ON ta.test_id = t.id "
             "WHERE ta.user_id = $1";
 
-        PGresult* res = PQexecParams((PGconn*)conn, sql, 1, nullptr, paramValues, nullptr, nullptr, 0);
+        PGresult* res = exec(__func__, sql, 1, paramValues);
+        out.key("grades").beginArray();
         if (PQresultStatus(res) == PGRES_TUPLES_OK) {
             for (int i = 0; i < PQntuples(res); i++) {
-                result["grades"][i]["test_title"] = PQgetvalue(res, i, 0);
-                result["grades"][i]["score"] = std::stod(PQgetvalue(res, i, 1));
-                result["grades"][i]["status"] = PQgetvalue(res, i, 2);
-                result["grades"][i]["date"] = PQgetvalue(res, i, 3);
+                out.beginObject()
+                    .field("test_title", PQgetvalue(res, i, 0))
+                    .field("score", std::stod(PQgetvalue(res, i, 1)))
+                    .field("status", PQgetvalue(res, i, 2))
+                    .field("date", PQgetvalue(res, i, 3))
+                    .endObject();
             }
         }
+        out.endArray();
         PQclear(res);
     }
 
-    return result;
+    out.endObject();
+    return out.str();
 }
@@ -0,0 +1,82 @@
+#pragma once
+#include "crow.h"
+#include "../domain/question.h"
+#include "../domain/test.h"
+#include <charconv>
+#include <libpq-fe.h>
+#include <string_view>
+#include <vector>
+
+// Разбор строк результата Postgres (текстовый формат) в доменные структуры.
+// Строка - любой тип с методом const char* get(int column) const:
+// PgRow для PGresult или заготовленные данные в бенчмарках.
+
+struct PgRow {
+    const PGresult* res;
+    int row;
+
+    const char* get(int column) const { return PQgetvalue(res, row, column); }
+};
+
+inline int parsePgInt(std::string_view text) {
+    int value = 0;
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+inline bool parsePgBool(const char* text) {
+    return text[0] == 't';
+}
+
+// Массив int[] в текстовом виде: {1,2,3}
+inline std::vector<int> parsePgIntArray(std::string_view text) {
+    std::vector<int> values;
+    if (text.size() < 2 || text.front() != '{' || text.back() != '}') return values;
+
+    const char* p = text.data() + 1;
+    const char* end = text.data() + text.size() - 1;
+    values.reserve((end - p) / 2 + 1);
+    while (p < end) {
+        int value = 0;
+        auto r = std::from_chars(p, end, value);
+        if (r.ec == std::errc()) values.push_back(value);
+        p = r.ptr;
+        while (p < end && *p != ',') ++p;
+        ++p;
+    }
+    return values;
+}
+
+// Колонки: id, version, author_id, title, content, options, correct_option, is_deleted
+template <typename Row>
+Question decodeQuestion(const Row& row) {
+    Question q;
+    q.id = parsePgInt(row.get(0));
+    q.version = parsePgInt(row.get(1));
+    q.author_id = row.get(2);
+    q.title = row.get(3);
+    q.content = row.get(4);
+
+    auto optionsJson = crow::json::load(row.get(5));
+    if (optionsJson) {
+        for (auto& opt : optionsJson) {
+            q.options.push_back(opt.s());
+        }
+    }
+
+    q.correct_option = parsePgInt(row.get(6));
+    q.is_deleted = parsePgBool(row.get(7));
+    return q;
+}
+
+// Колонки: id, course_id, title, is_active, is_deleted
+template <typename Row>
+Test decodeTest(const Row& row) {
+    Test t;
+    t.id = parsePgInt(row.get(0));
+    t.course_id = parsePgInt(row.get(1));
+    t.title = row.get(2);
+    t.is_active = parsePgBool(row.get(3));
+    t.is_deleted = parsePgBool(row.get(4));
+    return t;
+}
@@ -0,0 +1,66 @@
+#include "query_stats.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+QueryLogOptions QueryLogOptions::fromEnv() {
+    QueryLogOptions options;
+    if (const char* ms = std::getenv("DB_SLOW_QUERY_MS")) {
+        options.slowThreshold = std::chrono::milliseconds(std::strtol(ms, nullptr, 10));
+    }
+    if (const char* explain = std::getenv("DB_SLOW_QUERY_EXPLAIN")) {
+        options.explain = std::strcmp(explain, "1") == 0 || std::strcmp(explain, "true") == 0;
+    }
+    return options;
+}
+
+void QueryStats::record(std::string_view method, std::string_view sql, std::chrono::nanoseconds elapsed,
+                        uint64_t rows, uint64_t bytes, bool ok) {
+    std::string key;
+    key.reserve(method.size() + sql.size() + 1);
+    key.append(method).append(1, '\n').append(sql);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& entry = entries[key];
+    if (!entry) {
+        entry = std::make_unique<QueryStatsEntry>();
+        entry->method = std::string(method);
+        entry->sql = std::string(sql);
+    }
+    entry->calls++;
+    if (!ok) entry->errors++;
+    entry->rows += rows;
+    entry->bytes += bytes;
+    entry->totalTime += elapsed;
+    entry->maxTime = std::max(entry->maxTime, elapsed);
+}
+
+std::vector<QueryStatsEntry> QueryStats::top(size_t limit) const {
+    std::vector<QueryStatsEntry> result;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        result.reserve(entries.size());
+        for (const auto& [key, entry] : entries) {
+            result.push_back(*entry);
+        }
+    }
+
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+        return a.totalTime > b.totalTime;
+    });
+    if (result.size() > limit) result.resize(limit);
+    return result;
+}
+
+std::string redactParam(const char* value) {
+    if (!value) return "NULL";
+
+    size_t len = std::strlen(value);
+    bool numeric = len > 0 && len <= 20;
+    for (size_t i = 0; i < len && numeric; ++i) {
+        numeric = std::isdigit(static_cast<unsigned char>(value[i])) || (i == 0 && value[i] == '-');
+    }
+    if (numeric) return value;
+    return "<redacted " + std::to_string(len) + " bytes>";
+}
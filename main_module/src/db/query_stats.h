@@ -0,0 +1,46 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Настройки журнала медленных запросов (переопределяются переменными окружения)
+struct QueryLogOptions {
+    std::chrono::milliseconds slowThreshold{200};   // DB_SLOW_QUERY_MS, 0 - журнал выключен
+    bool explain = false;                           // DB_SLOW_QUERY_EXPLAIN=1 - добавлять план EXPLAIN
+
+    static QueryLogOptions fromEnv();
+};
+
+// Накопленная статистика одного запроса (метод DB + текст SQL)
+struct QueryStatsEntry {
+    std::string method;
+    std::string sql;
+    uint64_t calls = 0;
+    uint64_t errors = 0;
+    uint64_t rows = 0;
+    uint64_t bytes = 0;
+    std::chrono::nanoseconds totalTime{0};
+    std::chrono::nanoseconds maxTime{0};
+};
+
+// Статистика запросов слоя DB в памяти процесса (аналог pg_stat_statements для core)
+class QueryStats {
+public:
+    void record(std::string_view method, std::string_view sql, std::chrono::nanoseconds elapsed,
+                uint64_t rows, uint64_t bytes, bool ok);
+
+    // Самые дорогие запросы по суммарному времени
+    std::vector<QueryStatsEntry> top(size_t limit) const;
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<QueryStatsEntry>> entries;
+};
+
+// Параметры для журнала: числа остаются (id), остальное заменяется длиной значения
+std::string redactParam(const char* value);
@@ -1,4 +1,5 @@
 #pragma once
+#include "../http/json_writer.h"
 #include <string>
 #include <vector>
 
@@ -12,22 +13,22 @@ struct Question {
     int correct_option = 0;
     bool is_deleted = false;
 
-    crow::json::wvalue to_json() const {
-        crow::json::wvalue j;
-        j["id"] = id;
-        j["version"] = version;
-        j["author_id"] = author_id;
-        j["title"] = title;
-        j["content"] = content;
-        
-        crow::json::wvalue::list optList;
-        for (const auto& opt : options) {
-            optList.push_back(crow::json::wvalue(opt));
-        }
-        j["options"] = std::move(optList);
-        
-        j["correct_option"] = correct_option;
-        j["is_deleted"] = is_deleted;
-        return j;
+    void write_json(JsonWriter& out) const {
+        out.beginObject()
+            .field("id", id)
+            .field("version", version)
+            .field("author_id", author_id)
+            .field("title", title)
+            .field("content", content)
+            .field("options", options)
+            .field("correct_option", correct_option)
+            .field("is_deleted", is_deleted)
+            .endObject();
+    }
+
+    std::string to_json() const {
+        JsonWriter out;
+        write_json(out);
+        return out.str();
     }
 };
@@ -0,0 +1,116 @@
+#include "attempt_export.h"
+#include "../http/json_writer.h"
+#include <bit>
+#include <cstring>
+
+static_assert(std::endian::native == std::endian::little, "Export format is little-endian");
+
+AttemptExportWriter::AttemptExportWriter(int testId, const AnswerKey& key) : key(key) {
+    JsonWriter schema;
+    schema.beginObject()
+        .field("format", "core-attempts")
+        .field("version", (int)kVersion)
+        .field("test_id", testId)
+        .key("columns").beginArray()
+        .beginObject().field("name", "attempt_id").field("type", "int32").endObject()
+        .beginObject().field("name", "user_id").field("type", "int32").field("dictionary", true).endObject()
+        .beginObject().field("name", "status").field("type", "uint8")
+            .field("values", std::vector<std::string>{"in_progress", "completed"}).endObject()
+        .beginObject().field("name", "score").field("type", "float64").endObject();
+    for (int questionId : key.questionIds) {
+        schema.beginObject()
+            .field("name", "q_" + std::to_string(questionId))
+            .field("type", "int8")
+            .field("question_id", questionId)
+            .endObject();
+    }
+    schema.endArray().endObject();
+    std::string text = schema.str();
+
+    out.append("CATX", 4);
+    put<uint16_t>(kVersion);
+    put<uint16_t>(0);
+    put<uint32_t>((uint32_t)text.size());
+    out += text;
+    pad();
+}
+
+void AttemptExportWriter::pad() {
+    out.append((8 - out.size() % 8) % 8, '\0');
+}
+
+// Длина тела дописывается в endBlock
+void AttemptExportWriter::beginBlock(BlockType type) {
+    put<uint32_t>(type);
+    put<uint32_t>(0);
+    blockStart = out.size();
+    put<uint64_t>(0);
+}
+
+void AttemptExportWriter::endBlock() {
+    pad();
+    uint64_t length = out.size() - blockStart - sizeof(uint64_t);
+    std::memcpy(&out[blockStart], &length, sizeof(length));
+}
+
+void AttemptExportWriter::addBatch(const std::vector<AttemptExportRow>& rows) {
+    if (rows.empty()) return;
+
+    // Сначала новые пользователи этой порции
+    std::vector<const std::string*> added;
+    std::vector<int32_t> users;
+    users.reserve(rows.size());
+    for (const auto& row : rows) {
+        auto [it, inserted] = dictionary.emplace(row.userId, (int32_t)dictionary.size());
+        if (inserted) added.push_back(&it->first);
+        users.push_back(it->second);
+    }
+    if (!added.empty()) {
+        beginBlock(Dictionary);
+        put<uint32_t>((uint32_t)added.size());
+        put<uint32_t>(0);
+        uint32_t offset = 0;
+        put<uint32_t>(offset);
+        for (const auto* user : added) {
+            offset += (uint32_t)user->size();
+            put<uint32_t>(offset);
+        }
+        for (const auto* user : added) out += *user;
+        endBlock();
+    }
+
+    size_t n = rows.size();
+    std::vector<int32_t> ids(n);
+    std::vector<uint8_t> statuses(n);
+    std::vector<double> scores(n);
+    std::vector<std::vector<int8_t>> answers(key.size(), std::vector<int8_t>(n));
+    for (size_t i = 0; i < n; ++i) {
+        const auto& row = rows[i];
+        ids[i] = row.id;
+        statuses[i] = row.status == "in_progress" ? 0 : row.status == "completed" ? 1 : 0xff;
+        scores[i] = row.score;
+        answersInKeyOrder(key, row.answers, scratch);
+        for (size_t q = 0; q < key.size(); ++q) {
+            int answer = scratch[q];
+            answers[q][i] = (answer >= 0 && answer <= INT8_MAX) ? (int8_t)answer : -1;
+        }
+    }
+
+    beginBlock(Batch);
+    put<uint32_t>((uint32_t)n);
+    put<uint32_t>(0);
+    column(ids);
+    column(users);
+    column(statuses);
+    column(scores);
+    for (const auto& values : answers) column(values);
+    endBlock();
+    total += (long long)n;
+}
+
+std::string AttemptExportWriter::finish() {
+    beginBlock(End);
+    put<uint64_t>((uint64_t)total);
+    endBlock();
+    return std::move(out);
+}
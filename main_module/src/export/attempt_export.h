@@ -0,0 +1,66 @@
+#pragma once
+#include "../grading/grading.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Выгрузка попыток теста в столбцовом двоичном формате для офлайн-аналитики.
+//
+// Файл самоописываемый, little-endian, все столбцы выровнены на 8 байт,
+// поэтому его можно отобразить в память и читать столбцы без разбора:
+//
+//   "CATX" u16 версия u16 0 | u32 длина схемы | схема (JSON) | выравнивание
+//   блоки: u32 тип u32 0 u64 длина тела | тело (длина кратна 8)
+//     тип 1 - добавление в словарь user_id:
+//       u32 n u32 0 | u32 смещения[n + 1] | байты строк | выравнивание
+//     тип 2 - порция попыток:
+//       u32 rows u32 0 | столбцы в порядке схемы, каждый с выравниванием:
+//       attempt_id int32, user int32 (индекс в словаре), status uint8,
+//       score float64, q_<id> int8 на каждый вопрос теста (-1 - без ответа)
+//     тип 0 - конец: u64 всего попыток
+//
+// Словарь пополняется перед порцией, в которой впервые встречается пользователь,
+// индексы сквозные по всему файлу.
+
+struct AttemptExportRow {
+    int id = 0;
+    std::string userId;
+    std::string status;
+    double score = 0.0;
+    std::string answers;    // текст JSONB
+};
+
+class AttemptExportWriter {
+public:
+    static constexpr uint16_t kVersion = 1;
+    static constexpr const char* kContentType = "application/vnd.core.attempts";
+
+    enum BlockType : uint32_t { End = 0, Dictionary = 1, Batch = 2 };
+
+    // Столбцы ответов - вопросы key в его порядке
+    AttemptExportWriter(int testId, const AnswerKey& key);
+
+    void addBatch(const std::vector<AttemptExportRow>& rows);
+    // Дописывает блок конца и отдаёт файл
+    std::string finish();
+
+private:
+    template <typename T>
+    void put(T value) { out.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+    void pad();
+    void beginBlock(BlockType type);
+    void endBlock();
+    template <typename T>
+    void column(const std::vector<T>& values) {
+        out.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        pad();
+    }
+
+    const AnswerKey& key;
+    std::string out;
+    size_t blockStart = 0;
+    long long total = 0;
+    std::unordered_map<std::string, int32_t> dictionary;
+    std::vector<int> scratch;
+};
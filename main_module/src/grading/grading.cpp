@@ -0,0 +1,76 @@
+#include "grading.h"
+#include "../metrics/metrics.h"
+#include "crow.h"
+#include <charconv>
+#include <string>
+
+namespace {
+
+void skipSpaces(const char*& p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r')) ++p;
+}
+
+// Быстрый разбор плоского объекта {"<int>": <int>, ...}, как его отдаёт Postgres.
+// false - формат другой, нужен общий разбор
+bool parseFlatAnswers(const AnswerKey& key, std::string_view text, std::vector<int>& out) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+
+    skipSpaces(p, end);
+    if (p == end || *p++ != '{') return false;
+    skipSpaces(p, end);
+    if (p < end && *p == '}') return true;
+
+    while (p < end) {
+        int questionId = 0;
+        int answer = 0;
+        if (*p++ != '"') return false;
+        auto r = std::from_chars(p, end, questionId);
+        if (r.ec != std::errc() || r.ptr >= end || *r.ptr != '"') return false;
+        p = r.ptr + 1;
+        skipSpaces(p, end);
+        if (p == end || *p++ != ':') return false;
+        skipSpaces(p, end);
+        r = std::from_chars(p, end, answer);
+        if (r.ec != std::errc()) return false;
+        p = r.ptr;
+
+        auto it = key.position.find(questionId);
+        if (it != key.position.end()) out[it->second] = answer;
+
+        skipSpaces(p, end);
+        if (p == end) return false;
+        if (*p == '}') return true;
+        if (*p++ != ',') return false;
+        skipSpaces(p, end);
+    }
+    return false;
+}
+
+} // namespace
+
+AnswerKeyCache& answerKeyCache() {
+    static AnswerKeyCache cache(4096, std::chrono::hours(24));
+    static bool registered = (registerCacheMetrics("answer_key", cache), true);
+    (void)registered;
+    return cache;
+}
+
+void answersInKeyOrder(const AnswerKey& key, std::string_view userAnswers, std::vector<int>& out) {
+    out.assign(key.size(), -1);
+    if (parseFlatAnswers(key, userAnswers, out)) return;
+
+    // Нестандартные значения (строки, вложенные объекты): общий разбор, нечисловое - без ответа
+    out.assign(key.size(), -1);
+    auto json = crow::json::load(std::string(userAnswers));
+    if (!json || json.t() != crow::json::type::Object) return;
+    for (const auto& name : json.keys()) {
+        int questionId = 0;
+        auto r = std::from_chars(name.data(), name.data() + name.size(), questionId);
+        if (r.ec != std::errc()) continue;
+        auto it = key.position.find(questionId);
+        if (it != key.position.end() && json[name].t() == crow::json::type::Number) {
+            out[it->second] = (int)json[name].i();
+        }
+    }
+}
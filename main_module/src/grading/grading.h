@@ -0,0 +1,53 @@
+#pragma once
+#include "../cache/ttl_cache.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Оценка попыток по ключу ответов снимка.
+// Балл попытки - число вопросов, где выбранный вариант совпал с правильным.
+
+// Закреплённый снимок ([{"id", "version"}, ...]) ссылается только на неизменяемые
+// версии вопросов, поэтому всё, что из него выведено, можно кешировать без срока.
+// Старые снимки (массив id) ссылаются на последние версии.
+inline bool isPinnedSnapshot(std::string_view snapshot) {
+    return snapshot.substr(0, 2) == "[{" || snapshot == "[]";
+}
+
+// Правильные варианты вопросов снимка в его порядке
+struct AnswerKey {
+    std::vector<int> questionIds;
+    std::vector<int> correct;
+    std::unordered_map<int, int> position;   // id вопроса -> индекс в массивах
+
+    void add(int questionId, int correctOption) {
+        position.emplace(questionId, (int)questionIds.size());
+        questionIds.push_back(questionId);
+        correct.push_back(correctOption);
+    }
+
+    size_t size() const { return questionIds.size(); }
+};
+
+// Ключи закреплённых снимков, общие для всех соединений с базой (метрики: answer_key)
+using AnswerKeyCache = TtlCache<std::string, std::shared_ptr<const AnswerKey>, StringKeyHash>;
+AnswerKeyCache& answerKeyCache();
+
+// user_answers ({"12": 3, "15": -1}) в порядке ключа; без ответа - -1
+void answersInKeyOrder(const AnswerKey& key, std::string_view userAnswers, std::vector<int>& out);
+
+// Число совпадений; простой цикл без ветвлений, компилятор его векторизует
+inline int countCorrect(const int* answers, const int* correct, size_t n) {
+    int total = 0;
+    for (size_t i = 0; i < n; ++i) total += answers[i] == correct[i];
+    return total;
+}
+
+// scratch переиспользуется между вызовами, чтобы не выделять память на каждую попытку
+inline double gradeAttempt(const AnswerKey& key, std::string_view userAnswers, std::vector<int>& scratch) {
+    answersInKeyOrder(key, userAnswers, scratch);
+    return countCorrect(scratch.data(), key.correct.data(), key.size());
+}
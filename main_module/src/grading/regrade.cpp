@@ -0,0 +1,287 @@
+#include "regrade.h"
+#include "grading.h"
+#include "../db/db.h"
+#include "../http/json_writer.h"
+#include "crow.h"
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+constexpr size_t kKeptJobs = 100;
+// Сколько раз пересчитывать порцию, строки которой меняются параллельно
+constexpr int kMaxSaveRounds = 3;
+
+int envInt(const char* name, int fallback) {
+    const char* value = std::getenv(name);
+    if (!value) return fallback;
+    int parsed = std::atoi(value);
+    return parsed > 0 ? parsed : fallback;
+}
+
+// Ограниченная очередь порций между читающим потоком и обработчиками:
+// чтение не убегает вперёд записи больше чем на capacity порций
+class ChunkQueue {
+public:
+    explicit ChunkQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(std::vector<AttemptGradingRow> chunk) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&] { return items.size() < capacity || closed; });
+        if (closed) return;
+        items.push_back(std::move(chunk));
+        notEmpty.notify_one();
+    }
+
+    // false - очередь закрыта и пуста
+    bool pop(std::vector<AttemptGradingRow>& chunk) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [&] { return !items.empty() || closed; });
+        if (items.empty()) return false;
+        chunk = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    size_t capacity;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<std::vector<AttemptGradingRow>> items;
+    bool closed = false;
+};
+
+// Снимок с вопросами из latest, закреплёнными на последних версиях.
+// Текст в том же виде, в каком jsonb отдаёт Postgres, чтобы совпадали ключи кешей.
+std::string repinSnapshot(const std::string& snapshot, const std::unordered_map<int, int>& latest) {
+    if (!isPinnedSnapshot(snapshot)) return snapshot;
+    auto json = crow::json::load(snapshot);
+    if (!json) return snapshot;
+
+    std::string out = "[";
+    bool first = true;
+    for (const auto& item : json) {
+        int id = (int)item["id"].i();
+        int version = (int)item["version"].i();
+        auto it = latest.find(id);
+        if (it != latest.end()) version = it->second;
+        if (!first) out += ", ";
+        first = false;
+        out += "{\"id\": " + std::to_string(id) + ", \"version\": " + std::to_string(version) + "}";
+    }
+    return out + "]";
+}
+
+struct RepinnedSnapshot {
+    std::string snapshot;
+    std::shared_ptr<const AnswerKey> key;
+};
+
+const char* statusName(RegradeStatus status) {
+    switch (status) {
+        case RegradeStatus::Running: return "running";
+        case RegradeStatus::Done: return "done";
+        case RegradeStatus::Failed: return "failed";
+    }
+    return "unknown";
+}
+
+} // namespace
+
+RegradeOptions RegradeOptions::fromEnv() {
+    RegradeOptions options;
+    options.workers = envInt("REGRADE_WORKERS", options.workers);
+    options.chunkSize = envInt("REGRADE_CHUNK_SIZE", options.chunkSize);
+    return options;
+}
+
+std::string RegradeJob::to_json() const {
+    auto current = status.load();
+    double elapsed = current == RegradeStatus::Running
+        ? std::chrono::duration<double>(std::chrono::steady_clock::now() - startedAt).count()
+        : elapsedMs.load() / 1000.0;
+
+    JsonWriter out;
+    out.beginObject()
+        .field("id", id)
+        .field("scope", scope == RegradeScope::Test ? "test" : "question")
+        .field("target_id", targetId)
+        .field("status", statusName(current))
+        .field("total", total.load())
+        .field("processed", processed.load())
+        .field("updated", updated.load())
+        .field("elapsed_seconds", elapsed);
+    if (current == RegradeStatus::Failed) out.field("error", error);
+    out.endObject();
+    return out.str();
+}
+
+RegradeJobs::RegradeJobs(std::string conninfo, RegradeOptions options)
+    : conninfo(std::move(conninfo)), options(options) {}
+
+RegradeJobs::~RegradeJobs() {
+    if (runner.joinable()) runner.join();
+}
+
+int RegradeJobs::start(RegradeScope scope, int targetId, const std::string& requestedBy) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) return -1;
+    // Предыдущий поток уже закончил работу (running сброшен), осталось его забрать
+    if (runner.joinable()) runner.join();
+
+    auto job = std::make_shared<RegradeJob>();
+    job->id = nextId++;
+    job->scope = scope;
+    job->targetId = targetId;
+    job->requestedBy = requestedBy;
+
+    jobs[job->id] = job;
+    while (jobs.size() > kKeptJobs) jobs.erase(jobs.begin());
+
+    running = true;
+    runner = std::thread(&RegradeJobs::run, this, job);
+    return job->id;
+}
+
+std::shared_ptr<const RegradeJob> RegradeJobs::find(int jobId) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = jobs.find(jobId);
+    return it == jobs.end() ? nullptr : it->second;
+}
+
+void RegradeJobs::run(std::shared_ptr<RegradeJob> job) {
+    std::atomic<bool> failed{false};
+    try {
+        DB reader(conninfo);
+
+        std::vector<int> testIds;
+        std::vector<int> questionIds;
+        if (job->scope == RegradeScope::Test) {
+            testIds = {job->targetId};
+            questionIds = reader.getQuestionIdsByTestId(job->targetId);
+        } else {
+            testIds = reader.getTestIdsWithQuestion(job->targetId);
+            questionIds = {job->targetId};
+        }
+        const auto latest = reader.getLatestVersions(questionIds);
+        job->total = testIds.empty() ? 0 : reader.countAttempts(testIds);
+
+        ChunkQueue queue((size_t)options.workers * 2);
+
+        // Снимков у теста единицы, поэтому перезакрепление и ключ считаются один раз на снимок.
+        // Строки, изменившиеся между чтением и записью (попытку завершили, её перезакрепили),
+        // перечитываются и пересчитываются заново
+        auto worker = [&] {
+            DB db(conninfo);
+            std::unordered_map<std::string, RepinnedSnapshot> repinned;
+            std::vector<int> scratch;
+            std::vector<int> changedIds;
+            std::vector<int> saved;
+            std::vector<AttemptGradingRow> chunk;
+
+            while (queue.pop(chunk)) {
+                size_t chunkSize = chunk.size();
+                try {
+                    for (int round = 0; !chunk.empty(); ++round) {
+                        if (round == kMaxSaveRounds) {
+                            std::cerr << "Regrade: " << chunk.size() << " attempt(s) kept changing, left as is" << std::endl;
+                            failed = true;
+                            break;
+                        }
+
+                        JsonWriter batch;
+                        batch.beginArray();
+                        changedIds.clear();
+                        for (const auto& row : chunk) {
+                            auto it = repinned.find(row.snapshot);
+                            if (it == repinned.end()) {
+                                std::string snapshot = repinSnapshot(row.snapshot, latest);
+                                auto key = db.loadAnswerKey(snapshot);
+                                it = repinned.emplace(row.snapshot, RepinnedSnapshot{std::move(snapshot), std::move(key)}).first;
+                            }
+                            if (!it->second.key) {
+                                failed = true;
+                                continue;
+                            }
+
+                            bool graded = row.status == "completed";
+                            double score = graded ? gradeAttempt(*it->second.key, row.answers, scratch) : row.score;
+                            if (it->second.snapshot == row.snapshot && score == row.score) continue;
+
+                            batch.beginObject()
+                                .field("id", row.id)
+                                .key("snapshot").raw(it->second.snapshot)
+                                .field("score", score)
+                                .field("graded", graded)
+                                .key("old_snapshot").raw(row.snapshot)
+                                .field("old_status", row.status)
+                                .endObject();
+                            changedIds.push_back(row.id);
+                        }
+                        batch.endArray();
+
+                        if (changedIds.empty()) break;
+                        int rows = db.saveRegradedAttempts(batch.str(), saved);
+                        if (rows < 0) {
+                            failed = true;
+                            break;
+                        }
+                        job->updated += rows;
+                        if ((size_t)rows == changedIds.size()) break;
+
+                        std::sort(saved.begin(), saved.end());
+                        std::vector<int> lost;
+                        for (int id : changedIds) {
+                            if (!std::binary_search(saved.begin(), saved.end(), id)) lost.push_back(id);
+                        }
+                        chunk = db.getAttemptsByIds(lost);
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << "Regrade chunk failed: " << e.what() << std::endl;
+                    failed = true;
+                }
+                job->processed += (long long)chunkSize;
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (int i = 0; i < options.workers; ++i) workers.emplace_back(worker);
+
+        for (int testId : testIds) {
+            int afterId = 0;
+            while (true) {
+                auto chunk = reader.getAttemptsChunk(testId, afterId, options.chunkSize);
+                if (chunk.empty()) break;
+                afterId = chunk.back().id;
+                bool last = (int)chunk.size() < options.chunkSize;
+                queue.push(std::move(chunk));
+                if (last) break;
+            }
+        }
+        queue.close();
+        for (auto& w : workers) w.join();
+    } catch (const std::exception& e) {
+        job->error = e.what();
+        failed = true;
+    }
+
+    if (failed && job->error.empty()) job->error = "Database error, see core logs";
+    job->elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - job->startedAt).count();
+    job->status = failed ? RegradeStatus::Failed : RegradeStatus::Done;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+}
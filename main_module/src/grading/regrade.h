@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Фоновый пересчёт баллов после исправления вопросов.
+// Снимки затронутых попыток перезакрепляются на последние версии вопросов,
+// завершённые попытки оцениваются заново по новому ключу.
+
+struct RegradeOptions {
+    int workers = 4;        // REGRADE_WORKERS, у каждого своё соединение с базой
+    int chunkSize = 1000;   // REGRADE_CHUNK_SIZE, попыток в одном чтении и одном UPDATE
+
+    static RegradeOptions fromEnv();
+};
+
+enum class RegradeScope { Test, Question };
+enum class RegradeStatus { Running, Done, Failed };
+
+struct RegradeJob {
+    int id = 0;
+    RegradeScope scope = RegradeScope::Test;
+    int targetId = 0;
+    std::string requestedBy;
+    std::chrono::steady_clock::time_point startedAt = std::chrono::steady_clock::now();
+
+    std::atomic<RegradeStatus> status{RegradeStatus::Running};
+    std::atomic<long long> total{0};        // попыток в затронутых тестах
+    std::atomic<long long> processed{0};
+    std::atomic<long long> updated{0};      // строк, у которых изменился снимок или балл
+    std::atomic<long long> elapsedMs{0};    // заполняется по завершении
+    std::string error;                      // пишется до status = Failed
+
+    // {"id", "scope", "target_id", "status", "total", "processed", "updated", "elapsed_seconds", "error"}
+    std::string to_json() const;
+};
+
+// Одновременно выполняется один пересчёт, в отдельном потоке (не в потоках Crow)
+class RegradeJobs {
+public:
+    explicit RegradeJobs(std::string conninfo, RegradeOptions options = RegradeOptions::fromEnv());
+    ~RegradeJobs();
+
+    // Номер задачи; -1 - уже идёт другой пересчёт
+    int start(RegradeScope scope, int targetId, const std::string& requestedBy);
+    std::shared_ptr<const RegradeJob> find(int jobId) const;
+
+private:
+    void run(std::shared_ptr<RegradeJob> job);
+
+    std::string conninfo;
+    RegradeOptions options;
+    mutable std::mutex mutex;
+    std::map<int, std::shared_ptr<RegradeJob>> jobs;
+    int nextId = 1;
+    std::thread runner;
+    bool running = false;
+};
@@ -3,17 +3,19 @@
 #include "../db/db.h"
 #include "../security/jwt.h"
 #include "../security/access.h"
-#include "../security/auth_guard.h"
+#include "../app.h"
+#include "../http/etag.h"
+#include "user_expand.h"
+#include "../cache/test_bundle_cache.h"
+#include "../analytics/item_analysis.h"
+#include <unordered_set>
 
 
-inline void registerAttemptRoutes(crow::SimpleApp& app, DB& db) {
+inline void registerAttemptRoutes(CoreApp& app, DB& db, AuthServiceClient& authService, TestBundleCache& bundles) {
     // Список пользователей прошедших тест
     CROW_ROUTE(app, "/tests/<int>/passed-users").methods("GET"_method)
-    ([&db](const crow::request& req, int testId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db, &authService](const crow::request& req, int testId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto test = db.getTestById(testId);
         if (test.id == 0) return crow::response(404, "Test not found");
@@ -26,24 +28,30 @@ inline void registerAttemptRoutes(crow::SimpleApp& app, DB& db) {
                 false, 
                 nullptr
             };
-            if (checkAccess(ctx, rule, "").code != 200) {
+            if (checkAccess(ctx, rule, "") != 200) {
                 return crow::response(403, "Forbidden: Only course teacher can view results");
             }
         }
 
         std::vector<std::string> users = db.getUsersWhoPassedTest(testId);
 
-        crow::json::wvalue res;
-        res["user_ids"] = std::move(users);
-        return crow::response(200, res);
+        JsonWriter out;
+        out.beginObject();
+        if (wantsUserExpansion(req)) {
+            auto info = authService.getUsersInfo(users);
+            out.key("users").beginArray();
+            for (const auto& id : users) {
+                writeUserInfo(out, info, id);
+            }
+            out.endArray();
+        }
+        out.field("user_ids", users).endObject();
+        return jsonResponse(200, out.str());
     });
     // Оценки пользователей (свои оценки)
     CROW_ROUTE(app, "/tests/<int>/scores").methods("GET"_method)
-    ([&db](const crow::request& req, int testId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db, &authService](const crow::request& req, int testId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto test = db.getTestById(testId);
         if (test.id == 0) return crow::response(404, "Test not found");
@@ -55,7 +63,7 @@ inline void registerAttemptRoutes(crow::SimpleApp& app, DB& db) {
             nullptr
         };
 
-        bool hasGlobalRead = (checkAccess(ctx, rule, "").code == 200);
+        bool hasGlobalRead = (checkAccess(ctx, rule, "") == 200);
         bool isAuthor = (ctx.userId == course.author_id || hasGlobalRead);
 
         auto scores = db.getTestScores(testId, ctx.userId, isAuthor);
@@ -64,25 +72,32 @@ inline void registerAttemptRoutes(crow::SimpleApp& app, DB& db) {
             return crow::response(403, "Access denied or no completed attempts");
         }
 
-        crow::json::wvalue::list scores_json;
-        for (const auto& s : scores) {
-            crow::json::wvalue item;
-            item["user_id"] = s.user_id;
-            item["score"] = s.score;
-            scores_json.push_back(std::move(item));
+        std::unordered_map<std::string, std::string> users;
+        bool expand = wantsUserExpansion(req);
+        if (expand) {
+            std::vector<std::string> userIds;
+            userIds.reserve(scores.size());
+            for (const auto& s : scores) userIds.push_back(s.user_id);
+            users = authService.getUsersInfo(userIds);
         }
 
-        crow::json::wvalue res;
-        res["scores"] = std::move(scores_json);
-        return crow::response(200, res);
+        JsonWriter out;
+        out.beginObject().key("scores").beginArray();
+        for (const auto& s : scores) {
+            out.beginObject().field("user_id", s.user_id).field("score", s.score);
+            if (expand) {
+                out.key("user");
+                writeUserInfo(out, users, s.user_id);
+            }
+            out.endObject();
+        }
+        out.endArray().endObject();
+        return jsonResponse(200, out.str());
     });
     // Посмотреть ответы пользователей (или свои ответы)
     CROW_ROUTE(app, "/tests/<int>/answers").methods("GET"_method)
-    ([&db](const crow::request& req, int testId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int testId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto test = db.getTestById(testId);
         if (test.id == 0) return crow::response(404, "Test not found");
@@ -93,7 +108,7 @@ inline void registerAttemptRoutes(crow::SimpleApp& app, DB& db) {
             false, 
             nullptr
         };
-        bool hasGlobalRead = (checkAccess(ctx, rule, "").code == 200);
+        bool hasGlobalRead = (checkAccess(ctx, rule, "") == 200);
         bool isAuthor = (ctx.userId == course.author_id || hasGlobalRead);
 
         auto details = db.getTestAttemptDetails(testId, ctx.userId, isAuthor);
@@ -102,33 +117,95 @@ inline void registerAttemptRoutes(crow::SimpleApp& app, DB& db) {
             return crow::response(403, "Access denied: You can only view your own answers");
         }
 
-        crow::json::wvalue::list final_list;
+        JsonWriter out;
+        out.beginObject().key("attempts").beginArray();
         for (const auto& att : details) {
-            crow::json::wvalue item;
-            item["user_id"] = att.user_id;
-            
-            crow::json::wvalue::list ans_json;
+            out.beginObject().field("user_id", att.user_id).key("answers").beginArray();
             for (const auto& ans : att.answers) {
-                crow::json::wvalue a;
-                a["question"] = ans.question_text;
-                a["answer"] = ans.user_answer_text;
-                ans_json.push_back(std::move(a));
+                out.beginObject()
+                    .field("question", ans.question_text)
+                    .field("answer", ans.user_answer_text)
+                    .endObject();
             }
-            item["answers"] = std::move(ans_json);
-            final_list.push_back(std::move(item));
+            out.endArray().endObject();
         }
+        out.endArray().endObject();
+        return jsonResponse(200, out.str());
+    });
+    // Анализ заданий теста по завершённым попыткам (пересчитывается не чаще раза в минуту)
+    CROW_ROUTE(app, "/tests/<int>/analysis").methods("GET"_method)
+    ([&app, &db](const crow::request& req, int testId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
-        crow::json::wvalue res;
-        res["attempts"] = std::move(final_list);
-        return crow::response(200, res);
+        auto test = db.getTestById(testId);
+        if (test.id == 0 || test.is_deleted) return crow::response(404, "Test not found");
+        auto course = db.getCourseById(test.course_id);
+
+        if (ctx.userId != course.author_id) {
+            PermissionRule rule{
+                "test:answer:read", 
+                false, 
+                nullptr
+            };
+            if (checkAccess(ctx, rule, "") != 200) {
+                return crow::response(403, "Forbidden: Only course teacher can view item analysis");
+            }
+        }
+
+        auto cached = itemAnalysisCache().get(testId);
+        if (!cached) {
+            auto body = std::make_shared<const std::string>(itemAnalysisJson(testId, db.getAnswerColumns(testId)));
+            itemAnalysisCache().put(testId, body);
+            cached = body;
+        }
+
+        auto response = jsonResponse(200, **cached);
+        response.set_header("Cache-Control", "private, max-age=60");
+        return response;
+    });
+    // Выгрузка попыток теста в столбцовом формате (см. export/attempt_export.h)
+    CROW_ROUTE(app, "/tests/<int>/export").methods("GET"_method)
+    ([&app, &db](const crow::request& req, int testId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
+
+        auto test = db.getTestById(testId);
+        if (test.id == 0) return crow::response(404, "Test not found");
+        auto course = db.getCourseById(test.course_id);
+
+        if (ctx.userId != course.author_id) {
+            PermissionRule rule{
+                "test:answer:read", 
+                false, 
+                nullptr
+            };
+            if (checkAccess(ctx, rule, "") != 200) {
+                return crow::response(403, "Forbidden: Only course teacher can export attempts");
+            }
+        }
+
+        // Без ключа выгрузка вышла бы без столбцов ответов - как у теста без вопросов
+        std::string snapshot = db.getTestSnapshot(testId);
+        auto key = snapshot.empty() ? nullptr : db.loadAnswerKey(snapshot);
+        if (!key) return crow::response(500, "Database error during export");
+        AttemptExportWriter writer(testId, *key);
+
+        // Курсор держит соединение до конца выгрузки, общее соединение не занимаем
+        DB exportDb(db.connectionInfo());
+        bool ok = exportDb.streamTestAttempts(testId, 10000, [&writer](const std::vector<AttemptExportRow>& rows) {
+            writer.addBatch(rows);
+        });
+        if (!ok) return crow::response(500, "Database error during export");
+
+        crow::response response(200, writer.finish());
+        response.set_header("Content-Type", AttemptExportWriter::kContentType);
+        response.set_header("Content-Disposition", "attachment; filename=\"test-" + std::to_string(testId) + ".catx\"");
+        response.set_header("Cache-Control", "no-store");
+        return response;
     });
     // Создание попытки (Начало теста)
     CROW_ROUTE(app, "/tests/<int>/start").methods("POST"_method)
-    ([&db](const crow::request& req, int testId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int testId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto test = db.getTestById(testId);
         if (test.id == 0) return crow::response(404, "Test not found");
@@ -147,13 +224,32 @@ inline void registerAttemptRoutes(crow::SimpleApp& app, DB& db) {
         res["attempt_id"] = attemptId;
         return crow::response(201, res);
     });
+    // Все вопросы попытки одним ответом (закреплённые версии, без правильных ответов)
+    CROW_ROUTE(app, "/attempts/<int>/bundle").methods("GET"_method)
+    ([&app, &bundles, &db](const crow::request& req, int attemptId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
+
+        std::string snapshot = db.getAttemptSnapshot(attemptId, ctx.userId);
+        if (snapshot.empty()) {
+            return crow::response(403, "Forbidden: You do not own this attempt");
+        }
+
+        // Набор по закреплённому снимку неизменен
+        bool pinned = isPinnedSnapshot(snapshot);
+        auto etag = makeETag({std::hash<std::string>{}(snapshot)});
+        if (pinned && matchesETag(req, etag)) {
+            return notModified(etag, kImmutableCache);
+        }
+
+        auto bundle = bundles.get(snapshot);
+        auto response = jsonResponse(200, *bundle);
+        if (pinned) setCacheHeaders(response, etag, kImmutableCache);
+        return response;
+    });
     // Отправка ответов внутри попытки
     CROW_ROUTE(app, "/attempts/<int>/answers").methods("POST"_method)
-    ([&db](const crow::request& req, int attemptId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int attemptId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         if (!db.isAttemptOwnedBy(attemptId, ctx.userId)) {
             return crow::response(403, "Forbidden: You do not own this attempt");
@@ -173,17 +269,67 @@ inline void registerAttemptRoutes(crow::SimpleApp& app, DB& db) {
             return crow::response(400, "Cannot change answer: Attempt completed or not found");
         }
     });
+    // Несколько ответов за один запрос (автосохранение, отправка после потери связи)
+    CROW_ROUTE(app, "/attempts/<int>/answers:batch").methods("POST"_method)
+    ([&app, &db](const crow::request& req, int attemptId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
+        constexpr size_t kMaxBatchAnswers = 500;
+
+        auto body = crow::json::load(req.body);
+        if (!body || !body.has("answers") || body["answers"].t() != crow::json::type::List) {
+            return crow::response(400, "Missing answers list");
+        }
+        const auto& answers = body["answers"];
+        if (answers.size() == 0 || answers.size() > kMaxBatchAnswers) {
+            return crow::response(400, "answers must contain 1 to " + std::to_string(kMaxBatchAnswers) + " items");
+        }
+
+        std::unordered_set<int> seen;
+        JsonWriter batch;
+        batch.beginArray();
+        for (const auto& item : answers) {
+            if (item.t() != crow::json::type::Object || !item.has("question_id") || !item.has("answer_index") ||
+                item["question_id"].t() != crow::json::type::Number || item["answer_index"].t() != crow::json::type::Number) {
+                return crow::response(400, "Each answer needs numeric question_id and answer_index");
+            }
+            int questionId = (int)item["question_id"].i();
+            if (!seen.insert(questionId).second) {
+                return crow::response(400, "Duplicate question_id " + std::to_string(questionId));
+            }
+            batch.beginObject()
+                .field("question_id", questionId)
+                .field("answer_index", (int)item["answer_index"].i())
+                .endObject();
+        }
+        batch.endArray();
+
+        PermissionRule updateRule{"answer:update", false, nullptr};
+        bool hasPermission = (checkAccess(ctx, updateRule, "") == 200);
+
+        // Владелец проверяется в самом UPDATE; отдельный запрос - только чтобы выбрать код ошибки
+        std::string saved = db.saveAttemptAnswers(attemptId, ctx.userId, hasPermission, batch.str());
+        if (saved.empty()) {
+            if (!hasPermission && !db.isAttemptOwnedBy(attemptId, ctx.userId)) {
+                return crow::response(403, "Forbidden: Access denied");
+            }
+            return crow::response(400, "Update failed: Attempt completed or not found, or question is not in the attempt");
+        }
+
+        JsonWriter out;
+        out.beginObject()
+            .field("saved", (long long)seen.size())
+            .key("answers").raw(saved)
+            .endObject();
+        return jsonResponse(200, out.str());
+    });
     // Отправка ответа на конкретный вопрос
     CROW_ROUTE(app, "/attempts/<int>/questions/<int>/answer").methods("PATCH"_method)
-    ([&db](const crow::request& req, int attemptId, int questionId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int attemptId, int questionId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         bool isOwner = db.isAttemptOwnedBy(attemptId, ctx.userId);
         PermissionRule updateRule{"answer:update", false, nullptr};
-        bool hasPermission = (checkAccess(ctx, updateRule, "").code == 200);
+        bool hasPermission = (checkAccess(ctx, updateRule, "") == 200);
 
         if (!isOwner && !hasPermission) {
             return crow::response(403, "Forbidden: Access denied");
@@ -202,15 +348,12 @@ inline void registerAttemptRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Удалить ответ
     CROW_ROUTE(app, "/attempts/<int>/questions/<int>/answer").methods("DELETE"_method)
-    ([&db](const crow::request& req, int attemptId, int questionId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int attemptId, int questionId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         bool isOwner = db.isAttemptOwnedBy(attemptId, ctx.userId);
         PermissionRule delRule{"answer:del", false, nullptr};
-        bool hasPermission = (checkAccess(ctx, delRule, "").code == 200);
+        bool hasPermission = (checkAccess(ctx, delRule, "") == 200);
 
         if (!isOwner && !hasPermission) {
             return crow::response(403, "Forbidden: Access denied");
@@ -224,29 +367,31 @@ inline void registerAttemptRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Завершение попытки студентом
     CROW_ROUTE(app, "/attempts/<int>/complete").methods("POST"_method)
-    ([&db](const crow::request& req, int attemptId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int attemptId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         if (!db.isAttemptOwnedBy(attemptId, ctx.userId)) {
             return crow::response(403, "Forbidden: You do not own this attempt");
         }
 
-        if (db.completeAttempt(attemptId)) {
-            return crow::response(200, "Attempt completed successfully");
-        } else {
-            return crow::response(400, "Cannot complete: Attempt already finished or not found");
+        switch (db.completeAttempt(attemptId)) {
+            case CompleteResult::Completed:
+                return crow::response(200, "Attempt completed successfully");
+            case CompleteResult::NotInProgress:
+                return crow::response(400, "Cannot complete: Attempt already finished or not found");
+            case CompleteResult::Conflict: {
+                crow::response res(409, "Answers are still being saved, retry completing the attempt");
+                res.set_header("Retry-After", "1");
+                return res;
+            }
+            default:
+                return crow::response(500, "Database error");
         }
     });
     // Посмотреть попытку
     CROW_ROUTE(app, "/tests/<int>/attempts/<string>").methods("GET"_method)
-    ([&db](const crow::request& req, int testId, std::string targetUserId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int testId, std::string targetUserId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto test = db.getTestById(testId);
         if (test.id == 0) return crow::response(404, "Test not found");
@@ -260,7 +405,7 @@ inline void registerAttemptRoutes(crow::SimpleApp& app, DB& db) {
             false, 
             nullptr
         };
-        bool hasPermission = (checkAccess(ctx, readRule, "").code == 200);
+        bool hasPermission = (checkAccess(ctx, readRule, "") == 200);
 
         if (!isOwner && !isAuthor && !hasPermission) {
             return crow::response(403, "Forbidden: You can only view your own attempts or must be a teacher");
@@ -276,11 +421,8 @@ inline void registerAttemptRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Просмотр ответов пользователя в конкретном тесте
     CROW_ROUTE(app, "/tests/<int>/attempts/<string>/answers").methods("GET"_method)
-    ([&db](const crow::request& req, int testId, std::string targetUserId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int testId, std::string targetUserId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto test = db.getTestById(testId);
         if (test.id == 0) return crow::response(404, "Test not found");
@@ -295,7 +437,7 @@ inline void registerAttemptRoutes(crow::SimpleApp& app, DB& db) {
             false, 
             nullptr
         };
-        bool hasPermission = (checkAccess(ctx, readRule, "").code == 200);
+        bool hasPermission = (checkAccess(ctx, readRule, "") == 200);
 
         if (!isOwner && !isAuthor && !hasPermission) {
             return crow::response(403, "Forbidden: Access denied to view these answers");
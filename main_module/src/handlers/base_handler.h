@@ -1,23 +1,33 @@
 #pragma once
 #include "crow.h"
-#include "cpr/cpr.h"
 #include "course_handler.h"
 #include "test_handler.h"
 #include "question_handler.h"
 #include "attempt_handler.h"
 #include "user_handler.h"
 #include "notification_handler.h"
+#include "debug_handler.h"
+#include "regrade_handler.h"
+#include "stream_handler.h"
 #include "../db/db.h"
+#include "../services/auth_service.h"
+#include "../cache/test_bundle_cache.h"
+#include "../grading/regrade.h"
+#include "../stream/answer_stream.h"
 #include "../security/jwt.h"
 #include "../security/access.h"
-#include "../security/auth_guard.h"
+#include "../app.h"
 
 
-inline void registerRoutes(crow::SimpleApp& app, DB& db) {
-    registerCourseRoutes(app, db);
-    registerTestRoutes(app, db);
+inline void registerRoutes(CoreApp& app, DB& db, AuthServiceClient& authService, TestBundleCache& bundles,
+                           RegradeJobs& regrades, AnswerStreamHub& answerStream) {
+    registerCourseRoutes(app, db, authService);
+    registerTestRoutes(app, db, bundles);
     registerQuestionRoutes(app, db);
-    registerAttemptRoutes(app, db);
-    registerUserRoutes(app, db);
+    registerAttemptRoutes(app, db, authService, bundles);
+    registerUserRoutes(app, db, authService);
     registerNotificationRoutes(app, db);
+    registerDebugRoutes(app, db);
+    registerRegradeRoutes(app, db, regrades);
+    registerAnswerStreamRoutes(app, db, answerStream);
 }
\ No newline at end of file
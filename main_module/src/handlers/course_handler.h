@@ -3,39 +3,43 @@
 #include "../db/db.h"
 #include "../security/jwt.h"
 #include "../security/access.h"
-#include "../security/auth_guard.h"
+#include "../app.h"
+#include "user_expand.h"
+#include "../http/etag.h"
 
-inline void registerCourseRoutes(crow::SimpleApp& app, DB& db) {
+inline void registerCourseRoutes(CoreApp& app, DB& db, AuthServiceClient& authService) {
     // Получение всех курсов (название, описание)
     CROW_ROUTE(app, "/courses").methods("GET"_method)
     ([&db](const crow::request& req){
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+        auto etag = makeETag({db.changes().epoch(), db.changes().version(Entity::CourseList)});
+        if (matchesETag(req, etag)) {
+            return notModified(etag, kRevalidateCache);
+        }
 
         auto courses = db.getCourses();
-        std::vector<crow::json::wvalue> course_list;
+        JsonWriter out;
+        out.beginObject().key("courses").beginArray();
         for (auto& c : courses) {
             if (c.id != 0 && !c.is_deleted) {
-                crow::json::wvalue item;
-                item["id"] = c.id;
-                item["title"] = c.title;
-                item["description"] = c.description;
-                course_list.push_back(std::move(item));
+                out.beginObject()
+                    .field("id", c.id)
+                    .field("title", c.title)
+                    .field("description", c.description)
+                    .endObject();
             }
         }
-        crow::json::wvalue final_res;
-        final_res["courses"] = std::move(course_list);
-        return crow::response(final_res);
+        out.endArray().endObject();
+        auto res = jsonResponse(200, out.str());
+        setCacheHeaders(res, etag, kRevalidateCache);
+        return res;
     });
     // Получение курса по айди
     CROW_ROUTE(app, "/courses/<int>").methods("GET"_method)
     ([&db](const crow::request& req, int courseId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+        auto etag = makeETag({db.changes().epoch(), db.changes().version(Entity::Course, courseId)});
+        if (matchesETag(req, etag)) {
+            return notModified(etag, kRevalidateCache);
+        }
 
         auto course = db.getCourseById(courseId);
         if (course.id == 0 || course.is_deleted) {
@@ -46,22 +50,21 @@ inline void registerCourseRoutes(crow::SimpleApp& app, DB& db) {
         json_data["title"] = course.title;
         json_data["description"] = course.description;
         json_data["author_id"] = course.author_id;
-        return crow::response(json_data);
+        crow::response res(json_data);
+        setCacheHeaders(res, etag, kRevalidateCache);
+        return res;
     });
     // Создание курса
     CROW_ROUTE(app, "/courses").methods("POST"_method)
-    ([&db](const crow::request& req) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         PermissionRule rule {
             "course:add",
             false,
             nullptr
         };
-        auto check = checkAccess(ctx, rule, "").code;
+        auto check = checkAccess(ctx, rule, "");
         if (check != 200) {
             return crow::response(check);
         } 
@@ -83,11 +86,8 @@ inline void registerCourseRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Изменить курс
     CROW_ROUTE(app, "/courses/<int>").methods("PATCH"_method)
-    ([&db](const crow::request& req, int courseId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int courseId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto course = db.getCourseById(courseId);
         if (course.id == 0 || course.is_deleted) {
@@ -105,7 +105,7 @@ inline void registerCourseRoutes(crow::SimpleApp& app, DB& db) {
                 return ctx.userId == ownerId;
             }
         };
-        if (checkAccess(ctx, rule, course.author_id).code != 200) {
+        if (checkAccess(ctx, rule, course.author_id) != 200) {
             return crow::response(403, "Forbidden");
         } 
 
@@ -120,11 +120,8 @@ inline void registerCourseRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Удаление курса
     CROW_ROUTE(app, "/courses/<int>").methods("DELETE"_method)
-    ([&db](const crow::request& req, int courseId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int courseId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto course = db.getCourseById(courseId);
         if (course.id == 0 || course.is_deleted) {
@@ -138,7 +135,7 @@ inline void registerCourseRoutes(crow::SimpleApp& app, DB& db) {
                 return ctx.userId == ownerId;
             }
         };
-        if (checkAccess(ctx, rule, course.author_id).code != 200) {
+        if (checkAccess(ctx, rule, course.author_id) != 200) {
             return crow::response(403);
         } 
 
@@ -159,11 +156,8 @@ inline void registerCourseRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Добавить пользователя на курс
     CROW_ROUTE(app, "/courses/<int>/join").methods("POST"_method)
-    ([&db](const crow::request& req, int courseId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int courseId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto json_data = crow::json::load(req.body);
         if (!json_data || !json_data.has("user_id")) {
@@ -178,7 +172,7 @@ inline void registerCourseRoutes(crow::SimpleApp& app, DB& db) {
                 false,
                 nullptr
             };
-            if (checkAccess(ctx, rule, "").code != 200) {
+            if (checkAccess(ctx, rule, "") != 200) {
                 return crow::response(403);
             }
         }
@@ -200,11 +194,8 @@ inline void registerCourseRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Удалить пользователя из курса
     CROW_ROUTE(app, "/courses/<int>/leave").methods("DELETE"_method)
-    ([&db](const crow::request& req, int courseId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int courseId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto json_data = crow::json::load(req.body);
         if (!json_data || !json_data.has("user_id")) {
@@ -219,7 +210,7 @@ inline void registerCourseRoutes(crow::SimpleApp& app, DB& db) {
                 false,
                 nullptr
             };
-            if (checkAccess(ctx, rule, "").code != 200) {
+            if (checkAccess(ctx, rule, "") != 200) {
                 return crow::response(403);
             }
         }
@@ -240,11 +231,8 @@ inline void registerCourseRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Список студентов на курсе
     CROW_ROUTE(app, "/courses/<int>/students").methods("GET"_method)
-    ([&db](const crow::request& req, int courseId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db, &authService](const crow::request& req, int courseId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto course = db.getCourseById(courseId);
         if (course.id == 0 || course.is_deleted) {
@@ -257,14 +245,22 @@ inline void registerCourseRoutes(crow::SimpleApp& app, DB& db) {
                 false,
                 nullptr
             };
-            if (checkAccess(ctx, rule, "").code != 200) {
+            if (checkAccess(ctx, rule, "") != 200) {
                 return crow::response(403, "Forbidden");
             }
         }
         std::vector<std::string> studentIds = db.getStudentIdsByCourseId(courseId);
-        crow::json::wvalue response;
-        response["student_ids"] = std::move(studentIds); 
-
-        return crow::response(200, response);
+        JsonWriter out;
+        out.beginObject();
+        if (wantsUserExpansion(req)) {
+            auto users = authService.getUsersInfo(studentIds);
+            out.key("users").beginArray();
+            for (const auto& id : studentIds) {
+                writeUserInfo(out, users, id);
+            }
+            out.endArray();
+        }
+        out.field("student_ids", studentIds).endObject();
+        return jsonResponse(200, out.str());
     });
 }
@@ -0,0 +1,54 @@
+#pragma once
+#include "crow.h"
+#include "../db/db.h"
+#include "../security/access.h"
+#include "../app.h"
+#include "../http/json_writer.h"
+#include <chrono>
+#include <cstdlib>
+
+inline void registerDebugRoutes(CoreApp& app, DB& db) {
+    // Самые дорогие SQL-запросы по суммарному времени (?limit=N, по умолчанию 20)
+    CROW_ROUTE(app, "/debug/queries").methods("GET"_method)
+    ([&app, &db](const crow::request& req) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
+
+        PermissionRule rule{
+            "debug:read",
+            false,
+            nullptr
+        };
+        if (checkAccess(ctx, rule, "") != 200) {
+            return crow::response(403, "Forbidden");
+        }
+
+        size_t limit = 20;
+        if (const char* param = req.url_params.get("limit")) {
+            long value = std::strtol(param, nullptr, 10);
+            if (value <= 0) return crow::response(400, "limit must be a positive number");
+            limit = (size_t)value;
+        }
+
+        auto ms = [](std::chrono::nanoseconds d) {
+            return std::chrono::duration<double, std::milli>(d).count();
+        };
+
+        JsonWriter out;
+        out.beginObject().key("queries").beginArray();
+        for (const auto& q : db.queryStats().top(limit)) {
+            out.beginObject()
+                .field("method", q.method)
+                .field("sql", q.sql)
+                .field("calls", q.calls)
+                .field("errors", q.errors)
+                .field("total_ms", ms(q.totalTime))
+                .field("mean_ms", q.calls ? ms(q.totalTime) / q.calls : 0.0)
+                .field("max_ms", ms(q.maxTime))
+                .field("rows", q.rows)
+                .field("bytes", q.bytes)
+                .endObject();
+        }
+        out.endArray().endObject();
+        return jsonResponse(200, out.str());
+    });
+}
@@ -3,16 +3,13 @@
 #include "../db/db.h"
 #include "../security/jwt.h"
 #include "../security/access.h"
-#include "../security/auth_guard.h"
+#include "../app.h"
 
-inline void registerNotificationRoutes(crow::SimpleApp& app, DB& db) {
+inline void registerNotificationRoutes(CoreApp& app, DB& db) {
     // Получить уведомления
     CROW_ROUTE(app, "/notification").methods("GET"_method)
-    ([&db](const crow::request& req) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         crow::json::wvalue res;
         res["notifications"] = db.getUnsentNotifications(ctx.userId);
@@ -21,11 +18,8 @@ inline void registerNotificationRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Подтвердить что уведомления получены
     CROW_ROUTE(app, "/notification/confirm-tg").methods("POST"_method)
-    ([&db](const crow::request& req) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto body = crow::json::load(req.body);
         if (!body || !body.has("ids")) return crow::response(400, "Invalid JSON");
@@ -3,22 +3,21 @@
 #include "../db/db.h"
 #include "../security/jwt.h"
 #include "../security/access.h"
-#include "../security/auth_guard.h"
+#include "../app.h"
+#include "../http/etag.h"
+#include "../http/json_writer.h"
 
-inline void registerQuestionRoutes(crow::SimpleApp& app, DB& db) {
+inline void registerQuestionRoutes(CoreApp& app, DB& db) {
     // Создание вопроса
     CROW_ROUTE(app, "/questions").methods("POST"_method)
-    ([&db](const crow::request& req) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         PermissionRule rule{
             "quest:create", 
             false, 
             nullptr};
-        if (checkAccess(ctx, rule, "").code != 200) {
+        if (checkAccess(ctx, rule, "") != 200) {
             return crow::response(403, "Forbidden: Cannot create questions");
         }
 
@@ -48,11 +47,8 @@ inline void registerQuestionRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Удаление вопроса
     CROW_ROUTE(app, "/questions/<int>").methods("DELETE"_method)
-    ([&db](const crow::request& req, int questionId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int questionId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto question = db.getQuestionById(questionId);
         if (question.id == 0) return crow::response(404, "Question not found");
@@ -63,7 +59,7 @@ inline void registerQuestionRoutes(crow::SimpleApp& app, DB& db) {
                 false, 
                 nullptr
             };
-            if (checkAccess(ctx, rule, "").code != 200) {
+            if (checkAccess(ctx, rule, "") != 200) {
                 return crow::response(403, "Forbidden: You can only delete your own questions");
             }
         }
@@ -76,11 +72,8 @@ inline void registerQuestionRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Изменение вопроса
     CROW_ROUTE(app, "/questions/<int>").methods("PATCH"_method, "PUT"_method)
-    ([&db](const crow::request& req, int questionId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int questionId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         Question q = db.getQuestionById(questionId); 
         if (q.id == 0) return crow::response(404, "Question not found");
@@ -90,7 +83,7 @@ inline void registerQuestionRoutes(crow::SimpleApp& app, DB& db) {
             false, 
             nullptr
         };
-        if (checkAccess(ctx, rule, "").code != 200 && q.author_id != ctx.userId) {
+        if (checkAccess(ctx, rule, "") != 200 && q.author_id != ctx.userId) {
             return crow::response(403, "Forbidden: Missing quest:update permission");
         }
 
@@ -139,60 +132,67 @@ inline void registerQuestionRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Получить детали вопроса
     CROW_ROUTE(app, "/questions/<int>/<int>").methods("GET"_method)
-    ([&db](const crow::request& req, int questionId, int version) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int questionId, int version) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         PermissionRule rule{
             "quest:read", 
             false, 
             nullptr
         };
-        bool hasGlobalRead = (checkAccess(ctx, rule, "").code == 200);
+        bool hasGlobalRead = (checkAccess(ctx, rule, "") == 200);
+
+        // Содержимое версии неизменно, но удаление вопроса меняет is_deleted у всех версий
+        // (и доступ студентов): ETag включает счётчик удалений, кеш перепроверяется
+        auto etag = makeETag({db.changes().epoch(), db.changes().version(Entity::Question, questionId),
+                              (uint64_t)questionId, (uint64_t)version});
+        if (hasGlobalRead && matchesETag(req, etag)) {
+            return notModified(etag, kRevalidateCache);
+        }
 
         Question q = db.getQuestionByIdAndVersion(questionId, version);
         if (q.id == 0) return crow::response(404, "Question not found");
 
-        if (hasGlobalRead) return crow::response(200, q.to_json());
+        bool allowed = hasGlobalRead
+            || q.author_id == ctx.userId
+            || (!q.is_deleted && db.hasUserAttemptForQuestion(ctx.userId, questionId));
 
-        if (q.author_id == ctx.userId) return crow::response(200, q.to_json());
+        if (!allowed) {
+            return crow::response(403, "Access denied");
+        }
 
-        if (!q.is_deleted && db.hasUserAttemptForQuestion(ctx.userId, questionId)) {
-            return crow::response(200, q.to_json());
+        if (matchesETag(req, etag)) {
+            return notModified(etag, kRevalidateCache);
         }
 
-        return crow::response(403, "Access denied");
+        auto res = jsonResponse(200, q.to_json());
+        setCacheHeaders(res, etag, kRevalidateCache);
+        return res;
     });
     // Посмотреть список вопросов (своих)
     CROW_ROUTE(app, "/questions").methods("GET"_method)
-    ([&db](const crow::request& req) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         PermissionRule rule{
             "quest:list:read", 
             false, 
             nullptr};
-        bool canSeeAll = (checkAccess(ctx, rule, "").code == 200);
+        bool canSeeAll = (checkAccess(ctx, rule, "") == 200);
 
         auto questions = db.getQuestionsList(ctx.userId, canSeeAll);
 
-        crow::json::wvalue::list questions_json;
+        JsonWriter out;
+        out.beginObject().key("questions").beginArray();
         for (const auto& q : questions) {
-            crow::json::wvalue item;
-            item["id"] = q.id;
-            item["version"] = q.version;
-            item["author_id"] = q.author_id;
-            item["title"] = q.title;
-            questions_json.push_back(std::move(item));
+            out.beginObject()
+                .field("id", q.id)
+                .field("version", q.version)
+                .field("author_id", q.author_id)
+                .field("title", q.title)
+                .endObject();
         }
-
-        crow::json::wvalue res;
-        res["questions"] = std::move(questions_json);
-        return crow::response(200, res);
+        out.endArray().endObject();
+        return jsonResponse(200, out.str());
     });
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+#include "crow.h"
+#include "../db/db.h"
+#include "../security/jwt.h"
+#include "../security/access.h"
+#include "../app.h"
+#include "../http/json_writer.h"
+#include "../grading/regrade.h"
+
+inline crow::response regradeStarted(int jobId) {
+    if (jobId == -1) {
+        return crow::response(409, "Another regrade job is already running");
+    }
+    JsonWriter out;
+    out.beginObject().field("job_id", jobId).endObject();
+    auto response = jsonResponse(202, out.str());
+    response.set_header("Location", "/regrade/" + std::to_string(jobId));
+    return response;
+}
+
+inline void registerRegradeRoutes(CoreApp& app, DB& db, RegradeJobs& regrades) {
+    // Пересчёт всех попыток теста по последним версиям его вопросов
+    CROW_ROUTE(app, "/tests/<int>/regrade").methods("POST"_method)
+    ([&app, &db, &regrades](const crow::request& req, int testId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
+
+        auto test = db.getTestById(testId);
+        if (test.id == 0 || test.is_deleted) {
+            return crow::response(404, "Test not found");
+        }
+
+        auto course = db.getCourseById(test.course_id);
+        if (ctx.userId != course.author_id) {
+            PermissionRule rule{
+                "test:regrade",
+                false,
+                nullptr
+            };
+            if (checkAccess(ctx, rule, "") != 200) {
+                return crow::response(403, "Forbidden: Only course author can regrade tests");
+            }
+        }
+
+        return regradeStarted(regrades.start(RegradeScope::Test, testId, ctx.userId));
+    });
+    // Пересчёт попыток во всех тестах, где встречается исправленный вопрос
+    CROW_ROUTE(app, "/questions/<int>/regrade").methods("POST"_method)
+    ([&app, &db, &regrades](const crow::request& req, int questionId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
+
+        auto question = db.getQuestionById(questionId);
+        if (question.id == 0) return crow::response(404, "Question not found");
+
+        if (ctx.userId != question.author_id) {
+            PermissionRule rule{
+                "test:regrade",
+                false,
+                nullptr
+            };
+            if (checkAccess(ctx, rule, "") != 200) {
+                return crow::response(403, "Forbidden: You can only regrade your own questions");
+            }
+        }
+
+        return regradeStarted(regrades.start(RegradeScope::Question, questionId, ctx.userId));
+    });
+    // Прогресс пересчёта
+    CROW_ROUTE(app, "/regrade/<int>").methods("GET"_method)
+    ([&app, &regrades](const crow::request& req, int jobId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
+
+        auto job = regrades.find(jobId);
+        if (!job) return crow::response(404, "Regrade job not found");
+
+        if (ctx.userId != job->requestedBy) {
+            PermissionRule rule{
+                "test:regrade",
+                false,
+                nullptr
+            };
+            if (checkAccess(ctx, rule, "") != 200) {
+                return crow::response(403, "Forbidden");
+            }
+        }
+
+        auto response = jsonResponse(200, job->to_json());
+        response.set_header("Cache-Control", "no-store");
+        return response;
+    });
+}
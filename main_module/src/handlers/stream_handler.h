@@ -0,0 +1,82 @@
+#pragma once
+#include "crow.h"
+#include "../db/db.h"
+#include "../security/auth_guard.h"
+#include "../security/access.h"
+#include "../app.h"
+#include "../http/json_writer.h"
+#include "../stream/answer_stream.h"
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+
+// Данные подключения от onaccept до onopen
+struct AcceptedAnswerStream {
+    int attemptId;
+    std::string userId;
+    bool anyUser;
+};
+
+// Токен подключения: "Authorization: Bearer <token>", как у HTTP, либо подпротокол
+// для браузеров, которые не могут задать заголовки WebSocket:
+// new WebSocket(url, ["bearer", token]) -> "Sec-WebSocket-Protocol: bearer, <token>"
+inline std::string_view answerStreamToken(const crow::request& req) {
+    const std::string& auth = req.get_header_value("Authorization");
+    if (auth.rfind("Bearer ", 0) == 0) return std::string_view(auth).substr(7);
+
+    std::string_view protocols = req.get_header_value("Sec-WebSocket-Protocol");
+    size_t comma = protocols.find(',');
+    if (comma == std::string_view::npos || protocols.substr(0, comma) != "bearer") return {};
+    std::string_view token = protocols.substr(comma + 1);
+    while (!token.empty() && token.front() == ' ') token.remove_prefix(1);
+    return token.substr(0, token.find(','));
+}
+
+inline void registerAnswerStreamRoutes(CoreApp& app, DB& db, AnswerStreamHub& hub) {
+    // Поток ответов попытки: /attempts/stream?attempt_id=<id>, токен - см. answerStreamToken.
+    // Middleware на запрос upgrade не вызываются, поэтому JWT и владелец попытки проверяются здесь.
+    // mirrorprotocols: в ответе на handshake первый запрошенный подпротокол ("bearer"), иначе браузер
+    // закроет соединение; сам токен обратно не отправляется
+    CROW_WEBSOCKET_ROUTE(app, "/attempts/stream")
+        .max_payload(64 * 1024)
+        .mirrorprotocols()
+        .onaccept([&db](const crow::request& req, void** userdata) {
+            const char* attemptParam = req.url_params.get("attempt_id");
+            int attemptId = attemptParam ? std::atoi(attemptParam) : 0;
+            if (attemptId <= 0) return false;
+
+            UserContext ctx;
+            std::string_view token = answerStreamToken(req);
+            if (token.empty() || authGuardToken(token, ctx) != 200) return false;
+
+            PermissionRule updateRule{"answer:update", false, nullptr};
+            bool anyUser = (checkAccess(ctx, updateRule, "") == 200);
+            if (!anyUser && !db.isAttemptOwnedBy(attemptId, ctx.userId)) return false;
+
+            *userdata = new AcceptedAnswerStream{attemptId, ctx.userId, anyUser};
+            return true;
+        })
+        .onopen([&hub](crow::websocket::connection& conn) {
+            std::unique_ptr<AcceptedAnswerStream> accepted(static_cast<AcceptedAnswerStream*>(conn.userdata()));
+            conn.userdata(nullptr);
+            if (!accepted) {
+                conn.close("Not accepted", 1008);
+                return;
+            }
+            hub.open(conn, accepted->attemptId, std::move(accepted->userId), accepted->anyUser);
+        })
+        .onmessage([&hub](crow::websocket::connection& conn, const std::string& data, bool isBinary) {
+            std::string error = isBinary ? "Binary frames are not supported" : hub.receive(conn, data);
+            if (!error.empty()) {
+                JsonWriter out;
+                out.beginObject().field("error", error).endObject();
+                conn.send_text(out.str());
+            }
+        })
+        .onerror([&hub](crow::websocket::connection& conn, const std::string&) {
+            hub.close(conn);
+        })
+        .onclose([&hub](crow::websocket::connection& conn, const std::string&, uint16_t) {
+            hub.close(conn);
+        });
+}
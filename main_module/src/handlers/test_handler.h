@@ -3,16 +3,22 @@
 #include "../db/db.h"
 #include "../security/jwt.h"
 #include "../security/access.h"
-#include "../security/auth_guard.h"
+#include "../app.h"
+#include "../http/etag.h"
+#include "../http/json_writer.h"
+#include "../cache/test_bundle_cache.h"
 
-inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
+inline void registerTestRoutes(CoreApp& app, DB& db, TestBundleCache& bundles) {
     // Получение тестов по курсу
     CROW_ROUTE(app, "/courses/<int>/tests").methods("GET"_method)
-    ([&db](const crow::request& req, int courseId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int courseId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
+
+        auto etag = makeETag({
+            db.changes().epoch(),
+            db.changes().version(Entity::Course, courseId),
+            db.changes().version(Entity::CourseTests, courseId)
+        });
 
         auto course = db.getCourseById(courseId);
         if (course.id == 0 || course.is_deleted) {
@@ -27,32 +33,32 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
             false, 
             nullptr
         };
-        bool isAdmin = (checkAccess(ctx, adminRule, "").code == 200);
+        bool isAdmin = (checkAccess(ctx, adminRule, "") == 200);
 
         if (!isAuthor && !isEnrolled && !isAdmin) {
             return crow::response(403, "Access denied. You must be enrolled or be the author.");
         }
 
+        if (matchesETag(req, etag)) {
+            return notModified(etag, kRevalidateCache);
+        }
+
         auto tests = db.getTestsByCourseId(courseId);
         
-        std::vector<crow::json::wvalue> test_list;
+        JsonWriter out;
+        out.beginObject().key("tests").beginArray();
         for (auto& t : tests) {
-            crow::json::wvalue item;
-            item["id"] = t.id;
-            item["title"] = t.title;
-            test_list.push_back(std::move(item));
+            out.beginObject().field("id", t.id).field("title", t.title).endObject();
         }
-        crow::json::wvalue res;
-        res["tests"] = std::move(test_list);
-        return crow::response(200, res);
+        out.endArray().endObject();
+        auto response = jsonResponse(200, out.str());
+        setCacheHeaders(response, etag, kRevalidateCache);
+        return response;
     });
     // Создание теста по курсу
     CROW_ROUTE(app, "/courses/<int>/tests").methods("POST"_method)
-    ([&db](const crow::request& req, int courseId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int courseId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto course = db.getCourseById(courseId);
         if (course.id == 0 || course.is_deleted) {
@@ -65,7 +71,7 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
                 false, 
                 nullptr
             };
-            if (checkAccess(ctx, rule, "").code != 200) {
+            if (checkAccess(ctx, rule, "") != 200) {
                 return crow::response(403, "Forbidden");
             }
         }
@@ -90,11 +96,8 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
 
     // Удаление теста по id
     CROW_ROUTE(app, "/tests/<int>").methods("DELETE"_method)
-    ([&db](const crow::request& req, int testId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int testId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto test = db.getTestById(testId);
         if (test.id == 0 || test.is_deleted) {
@@ -109,7 +112,7 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
                 false, 
                 nullptr
             };
-            if (checkAccess(ctx, rule, "").code != 200) {
+            if (checkAccess(ctx, rule, "") != 200) {
                 return crow::response(403, "Forbidden: Only course author can delete tests");
             }
         }
@@ -131,11 +134,8 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Посмотреть информацию от тесте(Активный тест или нет) ccc
     CROW_ROUTE(app, "/courses/<int>/tests/<int>/status").methods("GET"_method)
-    ([&db](const crow::request& req, int courseId, int testId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int courseId, int testId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto course = db.getCourseById(courseId);
         auto test = db.getTestById(testId);
@@ -152,7 +152,7 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
             false, 
             nullptr
         };
-        bool isAdmin = (checkAccess(ctx, adminRule, "").code == 200);
+        bool isAdmin = (checkAccess(ctx, adminRule, "") == 200);
 
         if (!isAuthor && !isEnrolled && !isAdmin) {
             return crow::response(403, "Forbidden: You are not enrolled in this course");
@@ -165,11 +165,8 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Активация/деактивация теста
     CROW_ROUTE(app, "/courses/<int>/tests/<int>/activation").methods("PATCH"_method)
-    ([&db](const crow::request& req, int courseId, int testId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db, &bundles](const crow::request& req, int courseId, int testId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto course = db.getCourseById(courseId);
         auto test = db.getTestById(testId);
@@ -183,7 +180,7 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
                 false, 
                 nullptr
             };
-            if (checkAccess(ctx, rule, "").code != 200) {
+            if (checkAccess(ctx, rule, "") != 200) {
                 return crow::response(403, "Only course author can toggle test status");
             }
         }
@@ -199,6 +196,7 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
         }
 
         if (newStatus) {
+            bundles.build(testId);
             auto studentIds = db.getStudentIdsByCourseId(courseId);
             for (auto sId : studentIds) {
                 db.pushNotification(
@@ -212,7 +210,10 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
         } else {
             auto usersInProcess = db.getUsersWhoPassedTest(testId);
 
-            db.finalizeAllTestAttempts(testId);
+            // Тест уже закрыт; повторный запрос доберёт оставшиеся попытки
+            if (!db.finalizeAllTestAttempts(testId)) {
+                return crow::response(500, "Test closed, but some attempts were not finalized, retry");
+            }
 
             for (auto uId : usersInProcess) {
                 db.pushNotification(
@@ -229,11 +230,8 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Удаление вопроса из теста
     CROW_ROUTE(app, "/tests/<int>/questions/<int>").methods("DELETE"_method)
-    ([&db](const crow::request& req, int testId, int questionId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int testId, int questionId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto test = db.getTestById(testId);
         if (test.id == 0) return crow::response(404, "Test not found");
@@ -246,7 +244,7 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
                 false, 
                 nullptr
             };
-            if (checkAccess(ctx, rule, "").code != 200) {
+            if (checkAccess(ctx, rule, "") != 200) {
                 return crow::response(403, "Forbidden: You must be a course teacher or have test:quest:del permission");
             }
         }
@@ -259,11 +257,8 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Добавление вопроса в тест
     CROW_ROUTE(app, "/tests/<int>/questions/<int>").methods("POST"_method)
-    ([&db](const crow::request& req, int testId, int questionId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int testId, int questionId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto test = db.getTestById(testId);
         auto question = db.getQuestionById(questionId);
@@ -277,7 +272,7 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
                 false, 
                 nullptr
             };
-            if (checkAccess(ctx, rule, "").code != 200) {
+            if (checkAccess(ctx, rule, "") != 200) {
                 return crow::response(403, "Forbidden: You must be the course teacher AND the question author");
             }
         }
@@ -290,11 +285,8 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Изменение порядка вопросов в тесте
     CROW_ROUTE(app, "/tests/<int>/questions/reorder").methods("PATCH"_method)
-    ([&db](const crow::request& req, int testId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int testId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         auto test = db.getTestById(testId);
         if (test.id == 0) return crow::response(404, "Test not found");
@@ -306,7 +298,7 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
                 false, 
                 nullptr
             };
-            if (checkAccess(ctx, rule, "").code != 200) {
+            if (checkAccess(ctx, rule, "") != 200) {
                 return crow::response(403, "Forbidden: Only course teacher can reorder questions");
             }
         }
@@ -331,11 +323,10 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
 
     // Получить вопросы в тесте
     CROW_ROUTE(app, "/tests/<int>/question-ids").methods("GET"_method)
-    ([&db](const crow::request& req, int testId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, int testId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
+
+        auto etag = makeETag({db.changes().epoch(), db.changes().version(Entity::TestQuestions, testId)});
         
         int courseId = db.getCourseIdByTestId(testId);
         if (courseId == -1) {
@@ -345,16 +336,18 @@ inline void registerTestRoutes(crow::SimpleApp& app, DB& db) {
         if (!db.canAccessCourse(ctx.userId, courseId)) {
             return crow::response(403, "No access to this course");
         }
+
+        if (matchesETag(req, etag)) {
+            return notModified(etag, kRevalidateCache);
+        }
         
         auto questionIds = db.getQuestionIdsByTestId(testId);
         
-        crow::json::wvalue response;
-        for (size_t i = 0; i < questionIds.size(); i++) {
-            response[i] = questionIds[i];
-        }
-        
-        crow::response resp(200, response.dump());
-        resp.set_header("Content-Type", "application/json");
+        JsonWriter out;
+        out.value(questionIds);
+
+        auto resp = jsonResponse(200, out.str());
+        setCacheHeaders(resp, etag, kRevalidateCache);
         return resp;
     });
 }
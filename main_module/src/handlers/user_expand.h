@@ -0,0 +1,25 @@
+#pragma once
+#include "crow.h"
+#include "../services/auth_service.h"
+#include "../http/json_writer.h"
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// ?expand=users - вместе с id вернуть данные пользователей (ФИО и т.д.)
+inline bool wantsUserExpansion(const crow::request& req) {
+    const char* expand = req.url_params.get("expand");
+    return expand && std::string_view(expand) == "users";
+}
+
+// Объект пользователя из пакетного ответа auth-сервиса, null если его нет.
+// Тело от auth-сервиса уже JSON, поэтому пишется в ответ без разбора.
+inline void writeUserInfo(
+    JsonWriter& out,
+    const std::unordered_map<std::string, std::string>& users,
+    const std::string& userId
+) {
+    auto it = users.find(userId);
+    if (it == users.end()) out.null();
+    else out.raw(it->second);
+}
@@ -3,17 +3,16 @@
 #include "../db/db.h"
 #include "../security/jwt.h"
 #include "../security/access.h"
-#include "../security/auth_guard.h"
+#include "../app.h"
+#include "../services/auth_service.h"
+#include "../http/json_writer.h"
 
 
-inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
+inline void registerUserRoutes(CoreApp& app, DB& db, AuthServiceClient& authService) {
     // Информация о пользователе (курсы, оценки, тесты)
     CROW_ROUTE(app, "/users/<string>/data").methods("GET"_method)
-    ([&db](const crow::request& req, std::string targetUserId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &db](const crow::request& req, std::string targetUserId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         bool isOwner = (ctx.userId == targetUserId);
 
@@ -21,7 +20,7 @@ inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
             "user:data:read", 
             false, 
             nullptr};
-        bool hasAdminPermission = (checkAccess(ctx, readRule, "").code == 200);
+        bool hasAdminPermission = (checkAccess(ctx, readRule, "") == 200);
 
         if (!isOwner && !hasAdminPermission) {
             return crow::response(403, "Forbidden: You can only view your own data");
@@ -35,19 +34,12 @@ inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
             includeCourses = includeTests = includeGrades = true; 
         }
 
-        auto data = db.getUserDataProfile(targetUserId, includeCourses, includeTests, includeGrades);
-
-        std::cout << data.dump(2);
-
-        return crow::response(200, std::move(data));
+        return jsonResponse(200, db.getUserDataProfile(targetUserId, includeCourses, includeTests, includeGrades));
     });
     // Посмотреть список пользователей
     CROW_ROUTE(app, "/users").methods("GET"_method)
-    ([&db](const crow::request& req) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &authService](const crow::request& req) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         PermissionRule readRule{
             "user:list:read", 
@@ -55,55 +47,33 @@ inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
             nullptr
         };
 
-        if (checkAccess(ctx, readRule, "").code != 200) {
+        if (checkAccess(ctx, readRule, "") != 200) {
             return crow::response(403, "Forbidden");
         }
 
-        cpr::Response r = cpr::Get(
-            cpr::Url{"http://auth:8081/userservice/get_user_list"},
-            cpr::Header{{"Content-Type", "application/json"},},
-            cpr::Timeout{3000}
-        );
+        auto r = authService.getUserList();
 
-        if (r.status_code == 200) {
-            return crow::response(200, r.text);
+        if (r.ok()) {
+            return crow::response(200, r.body);
         } else {
             return crow::response(500, "Error from auth-service");
         }
     });
     // Посмотреть информацию о пользователе (ФИО)
     CROW_ROUTE(app, "/users/<string>").methods("GET"_method)
-    ([&db](const crow::request& req, std::string targetUserId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
-
-        crow::json::wvalue cmd;
-        cmd["user_id"] = targetUserId;
-
-        cpr::Response r = cpr::Get(
-            cpr::Url{"http://auth:8081/userservice/get_user_info"},
-            cpr::Body{cmd.dump()},
-            cpr::Header{{"Content-Type", "application/json"}},
-            cpr::Timeout{3000}
-        );
-
-        std::cout << r.text;
-
-        if (r.status_code == 200) {
-            return crow::response(200, r.text);
+    ([&authService](const crow::request& req, std::string targetUserId) {
+        auto r = authService.getUserInfo(targetUserId);
+
+        if (r.ok()) {
+            return crow::response(200, r.body);
         } else {
             return crow::response(500, "Error from auth-service");
         }
     });
     // Изменить ФИО пользователя
     CROW_ROUTE(app, "/users/<string>/name").methods("PATCH"_method)
-    ([&db](const crow::request& req, std::string targetUserId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &authService](const crow::request& req, std::string targetUserId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         bool isSelf = (ctx.userId == targetUserId);
 
@@ -113,7 +83,7 @@ inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
             nullptr
         };
 
-        bool hasAdminRule = (checkAccess(ctx, readRule, "").code == 200);
+        bool hasAdminRule = (checkAccess(ctx, readRule, "") == 200);
 
         if (!isSelf && !hasAdminRule) {
             return crow::response(403, "Forbidden: You can only change your own name");
@@ -125,18 +95,9 @@ inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
         }
         std::string newName = data["full_name"].s();
 
-        crow::json::wvalue cmd;
-        cmd["user_id"] = targetUserId;
-        cmd["new_name"] = newName;
+        auto r = authService.updateFullName(targetUserId, newName);
 
-        cpr::Response r = cpr::Patch(
-            cpr::Url{"http://auth:8081/userservice/update_full_name"},
-            cpr::Body{cmd.dump()},
-            cpr::Header{{"Content-Type", "application/json"}},
-            cpr::Timeout{3000}
-        );
-
-        if (r.status_code == 200) {
+        if (r.ok()) {
             return crow::response(200, "Full name updated successfully");
         } else {
             return crow::response(500, "Error from auth-service");
@@ -144,11 +105,8 @@ inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Посмотреть роли пользователя
     CROW_ROUTE(app, "/users/<string>/roles").methods("GET"_method)
-    ([&db](const crow::request& req, std::string targetUserId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &authService](const crow::request& req, std::string targetUserId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         PermissionRule readRule{
             "user:roles:read", 
@@ -156,35 +114,22 @@ inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
             nullptr
         };
 
-        if (checkAccess(ctx, readRule, "").code != 200) {
+        if (checkAccess(ctx, readRule, "") != 200) {
             return crow::response(403, "Forbidden");
         }
 
-        crow::json::wvalue cmd;
-        cmd["user_id"] = targetUserId;
-
-        cpr::Response r = cpr::Get(
-            cpr::Url{"http://auth:8081/userservice/get_user_roles"},
-            cpr::Body{cmd.dump()},
-            cpr::Header{{"Content-Type", "application/json"}},
-            cpr::Timeout{3000}
-        );
+        auto r = authService.getUserRoles(targetUserId);
 
-        std::cout << r.text;
-
-        if (r.status_code == 200) {
-            return crow::response(200, r.text);
+        if (r.ok()) {
+            return crow::response(200, r.body);
         } else {
             return crow::response(500, "Error from auth-service");
         }
     });
     // Изменить роли пользователю
     CROW_ROUTE(app, "/users/<string>/roles").methods("PATCH"_method)
-    ([&db](const crow::request& req, std::string targetUserId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &authService](const crow::request& req, std::string targetUserId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         PermissionRule readRule{
             "user:roles:write", 
@@ -192,7 +137,7 @@ inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
             nullptr
         };
 
-        if (checkAccess(ctx, readRule, "").code != 200) {
+        if (checkAccess(ctx, readRule, "") != 200) {
             return crow::response(403, "Forbidden");
         }
 
@@ -201,18 +146,9 @@ inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
             return crow::response(400, "Invalid JSON: expected { 'roles': ['role1', 'role2'] }");
         }
 
-        crow::json::wvalue cmd;
-        cmd["user_id"] = targetUserId;
-        cmd["roles"] = data["roles"];
-
-        cpr::Response r = cpr::Patch(
-            cpr::Url{"http://auth:8081/userservice/update_user_roles"},
-            cpr::Body{cmd.dump()},
-            cpr::Header{{"Content-Type", "application/json"}},
-            cpr::Timeout{3000}
-        );
+        auto r = authService.updateRoles(targetUserId, data["roles"]);
 
-        if (r.status_code == 200) {
+        if (r.ok()) {
             return crow::response(200, "Roles updated successfully");
         } else {
             return crow::response(500, "Error from auth-service");
@@ -220,11 +156,8 @@ inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
     });
     // Посмотреть заблокирован ли пользователь
     CROW_ROUTE(app, "/users/<string>/block-status").methods("GET"_method)
-    ([&db](const crow::request& req, std::string targetUserId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &authService](const crow::request& req, std::string targetUserId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         PermissionRule readRule{
             "user:block:read", 
@@ -232,33 +165,22 @@ inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
             nullptr
         };
 
-        if (checkAccess(ctx, readRule, "").code != 200) {
+        if (checkAccess(ctx, readRule, "") != 200) {
             return crow::response(403, "Forbidden");
         }
 
-        crow::json::wvalue cmd;
-        cmd["user_id"] = targetUserId;
+        auto r = authService.getBlockStatus(targetUserId);
 
-        cpr::Response r = cpr::Get(
-            cpr::Url{"http://auth:8081/userservice/get_user_block_status"},
-            cpr::Body{cmd.dump()},
-            cpr::Header{{"Content-Type", "application/json"}},
-            cpr::Timeout{3000}
-        );
-
-        if (r.status_code == 200) {
-            return crow::response(200, r.text);
+        if (r.ok()) {
+            return crow::response(200, r.body);
         } else {
             return crow::response(500, "Error from auth-service");
         }
     });
     // Заблокировать/Разблокировать пользователя
     CROW_ROUTE(app, "/users/<string>/block").methods("POST"_method)
-    ([&db](const crow::request& req, std::string targetUserId) {
-        UserContext ctx;
-        auto auth = authGuard(req, ctx);
-        if (auth == 418) return crow::response(403, "Blocked");
-        if (auth == 401) return crow::response(401, "Unauthorized");
+    ([&app, &authService](const crow::request& req, std::string targetUserId) {
+        const auto& ctx = app.get_context<AuthMiddleware>(req).user;
 
         if (ctx.userId == targetUserId) {
             return crow::response(403, "Forbidden: You cannot block/unblock yourself");
@@ -270,7 +192,7 @@ inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
             nullptr
         };
 
-        if (checkAccess(ctx, readRule, "").code != 200) {
+        if (checkAccess(ctx, readRule, "") != 200) {
             return crow::response(403, "Forbidden");
         }
 
@@ -280,18 +202,9 @@ inline void registerUserRoutes(crow::SimpleApp& app, DB& db) {
         }
         bool shouldBlock = data["is_blocked"].b();
 
-        crow::json::wvalue cmd;
-        cmd["user_id"] = targetUserId;
-        cmd["is_blocked"] = shouldBlock;
-
-        cpr::Response r = cpr::Post(
-            cpr::Url{"http://auth:8081/userservice/set_block_status"},
-            cpr::Body{cmd.dump()},
-            cpr::Header{{"Content-Type", "application/json"}},
-            cpr::Timeout{3000}
-        );
+        auto r = authService.setBlockStatus(targetUserId, shouldBlock);
 
-        if (r.status_code == 200) {
+        if (r.ok()) {
             return crow::response(200, shouldBlock ? "User blocked" : "User unblocked");
         } else {
             return crow::response(500, "Error from auth-service");
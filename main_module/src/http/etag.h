@@ -0,0 +1,80 @@
+#pragma once
+#include "crow.h"
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+// Условные GET: ETag / If-None-Match
+
+// Изменяемые ресурсы: кешировать можно, но перед использованием перепроверять
+inline constexpr const char* kRevalidateCache = "private, no-cache";
+// Неизменяемые ресурсы (вопросы закреплённого снимка попытки)
+inline constexpr const char* kImmutableCache = "private, max-age=31536000, immutable";
+
+inline std::string makeETag(std::initializer_list<uint64_t> parts) {
+    std::string etag = "\"";
+    bool first = true;
+    for (uint64_t part : parts) {
+        if (!first) etag += '-';
+        etag += std::to_string(part);
+        first = false;
+    }
+    etag += '"';
+    return etag;
+}
+
+// Сжатое представление получает свой ETag: "<etag>-gz" / "<etag>-zst" (ставит CompressionMiddleware)
+inline constexpr std::string_view kETagCodingSuffixes[] = {"-gz", "-zst"};
+
+inline std::string codedETag(std::string_view etag, std::string_view suffix) {
+    if (etag.size() < 2 || etag.back() != '"') return std::string(etag);
+    std::string coded(etag.substr(0, etag.size() - 1));
+    coded += suffix;
+    coded += '"';
+    return coded;
+}
+
+// Значение из If-None-Match относится к ресурсу с этим ETag: само или его сжатое представление
+inline bool sameResourceETag(std::string_view item, std::string_view etag) {
+    if (item.substr(0, 2) == "W/") item.remove_prefix(2);
+    if (item == etag) return true;
+    if (etag.size() < 2 || item.size() <= etag.size() || item.back() != '"') return false;
+    std::string_view open = etag.substr(0, etag.size() - 1);
+    if (item.substr(0, open.size()) != open) return false;
+    std::string_view suffix = item.substr(open.size(), item.size() - open.size() - 1);
+    for (std::string_view known : kETagCodingSuffixes) {
+        if (suffix == known) return true;
+    }
+    return false;
+}
+
+// Совпадает ли If-None-Match с текущим ETag (список значений, W/ и * поддерживаются)
+inline bool matchesETag(const crow::request& req, const std::string& etag) {
+    const std::string& header = req.get_header_value("If-None-Match");
+    if (header.empty()) return false;
+
+    std::string_view rest(header);
+    while (!rest.empty()) {
+        size_t comma = rest.find(',');
+        std::string_view item = rest.substr(0, comma);
+        rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+
+        while (!item.empty() && item.front() == ' ') item.remove_prefix(1);
+        while (!item.empty() && item.back() == ' ') item.remove_suffix(1);
+
+        if (item == "*" || sameResourceETag(item, etag)) return true;
+    }
+    return false;
+}
+
+inline void setCacheHeaders(crow::response& res, const std::string& etag, const char* cacheControl) {
+    res.set_header("ETag", etag);
+    res.set_header("Cache-Control", cacheControl);
+}
+
+inline crow::response notModified(const std::string& etag, const char* cacheControl) {
+    crow::response res(304);
+    setCacheHeaders(res, etag, cacheControl);
+    return res;
+}
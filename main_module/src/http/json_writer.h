@@ -0,0 +1,179 @@
+#pragma once
+#include "crow.h"
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Потоковая запись JSON прямо в буфер, без дерева crow::json::wvalue.
+// Буферы берутся из пула потока и возвращаются в него, поэтому после прогрева
+// запись списка не делает аллокаций кроме итоговой строки ответа.
+//
+//     JsonWriter w;
+//     w.beginObject().key("courses").beginArray();
+//     for (auto& c : courses) w.beginObject().field("id", c.id).field("title", c.title).endObject();
+//     w.endArray().endObject();
+//     return jsonResponse(200, w.str());
+class JsonWriter {
+public:
+    JsonWriter() : out(acquire()) {}
+    ~JsonWriter() { release(std::move(out)); }
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    JsonWriter& beginObject() { separate(); out.push_back('{'); push(); return *this; }
+    JsonWriter& endObject() { pop(); out.push_back('}'); return *this; }
+    JsonWriter& beginArray() { separate(); out.push_back('['); push(); return *this; }
+    JsonWriter& endArray() { pop(); out.push_back(']'); return *this; }
+
+    JsonWriter& key(std::string_view name) {
+        separate();
+        writeString(name);
+        out.push_back(':');
+        afterKey = true;
+        return *this;
+    }
+
+    JsonWriter& value(std::string_view s) { separate(); writeString(s); return *this; }
+    JsonWriter& value(const std::string& s) { return value(std::string_view(s)); }
+    JsonWriter& value(const char* s) { return s ? value(std::string_view(s)) : null(); }
+    JsonWriter& value(bool b) { separate(); out += b ? "true" : "false"; return *this; }
+    JsonWriter& value(int n) { return integer(n); }
+    JsonWriter& value(long n) { return integer(n); }
+    JsonWriter& value(long long n) { return integer(n); }
+    JsonWriter& value(unsigned n) { return integer(n); }
+    JsonWriter& value(unsigned long n) { return integer(n); }
+    JsonWriter& value(unsigned long long n) { return integer(n); }
+
+    JsonWriter& value(double d) {
+        if (!std::isfinite(d)) return null();
+        separate();
+        char buf[32];
+        auto r = std::to_chars(buf, buf + sizeof(buf), d);
+        out.append(buf, r.ptr);
+        return *this;
+    }
+
+    JsonWriter& null() { separate(); out += "null"; return *this; }
+
+    // Уже сериализованный JSON (кеш, ответ другого сервиса)
+    JsonWriter& raw(std::string_view json) { separate(); out.append(json); return *this; }
+
+    template <typename T>
+    JsonWriter& field(std::string_view name, const T& v) {
+        key(name);
+        return value(v);
+    }
+
+    template <typename T>
+    JsonWriter& value(const std::vector<T>& items) {
+        beginArray();
+        for (const auto& item : items) value(item);
+        return endArray();
+    }
+
+    // Копия результата; буфер с его ёмкостью остаётся в пуле
+    std::string str() const { return out; }
+
+private:
+    static constexpr int kMaxDepth = 64;
+
+    template <typename N>
+    JsonWriter& integer(N n) {
+        separate();
+        char buf[24];
+        auto r = std::to_chars(buf, buf + sizeof(buf), n);
+        out.append(buf, r.ptr);
+        return *this;
+    }
+
+    // Запятая перед очередным элементом массива/объекта
+    void separate() {
+        if (afterKey) {
+            afterKey = false;
+            return;
+        }
+        if (depth == 0) return;
+        uint64_t bit = uint64_t{1} << (depth - 1);
+        if (hasItems & bit) out.push_back(',');
+        hasItems |= bit;
+    }
+
+    void push() {
+        if (depth < kMaxDepth) {
+            ++depth;
+            hasItems &= ~(uint64_t{1} << (depth - 1));
+        }
+    }
+
+    void pop() {
+        if (depth > 0) --depth;
+    }
+
+    void writeString(std::string_view s) {
+        static constexpr char hex[] = "0123456789abcdef";
+        out.push_back('"');
+        size_t plain = 0;
+        for (size_t i = 0; i < s.size(); ++i) {
+            unsigned char c = static_cast<unsigned char>(s[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+            out.append(s.data() + plain, i - plain);
+            plain = i + 1;
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\b': out += "\\b"; break;
+                case '\f': out += "\\f"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    out += "\\u00";
+                    out.push_back(hex[c >> 4]);
+                    out.push_back(hex[c & 0xF]);
+            }
+        }
+        out.append(s.data() + plain, s.size() - plain);
+        out.push_back('"');
+    }
+
+    // Пул буферов потока: вложенные JsonWriter получают разные буферы
+    static std::vector<std::string>& pool() {
+        thread_local std::vector<std::string> buffers;
+        return buffers;
+    }
+
+    static std::string acquire() {
+        auto& buffers = pool();
+        if (buffers.empty()) return {};
+        std::string buffer = std::move(buffers.back());
+        buffers.pop_back();
+        return buffer;
+    }
+
+    // Слишком большие буферы не держим, чтобы разовый экспорт не занимал память потока
+    static void release(std::string&& buffer) {
+        auto& buffers = pool();
+        if (buffers.size() >= kPoolSize || buffer.capacity() > kMaxPooledCapacity) return;
+        buffer.clear();
+        buffers.push_back(std::move(buffer));
+    }
+
+    static constexpr size_t kPoolSize = 4;
+    static constexpr size_t kMaxPooledCapacity = 4 * 1024 * 1024;
+
+    std::string out;
+    uint64_t hasItems = 0;
+    int depth = 0;
+    bool afterKey = false;
+};
+
+// Ответ с уже сериализованным JSON
+inline crow::response jsonResponse(int code, std::string body) {
+    crow::response res(code, std::move(body));
+    res.set_header("Content-Type", "application/json");
+    return res;
+}
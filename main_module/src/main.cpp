@@ -1,10 +1,17 @@
 #include "crow.h"
 #include "db/db.h"
+#include "app.h"
 #include "handlers/base_handler.h"
+#include "security/jwt.h"
+#include "services/auth_service.h"
+#include "cache/test_bundle_cache.h"
+#include "grading/regrade.h"
+#include "stream/answer_stream.h"
+#include "metrics/metrics.h"
 #include <cstdlib>
 
 int main() {
-    crow::SimpleApp app;
+    CoreApp app;
     const char* env_conn = std::getenv("DB_CONNINFO");
 
     if (!env_conn) {
@@ -12,14 +19,32 @@ int main() {
         return 1; 
     }
 
+    if (!initJWT()) {
+        std::cerr << "CRITICAL ERROR: JWT_SECRET_KEY not found in environment!" << std::endl;
+        return 1;
+    }
+
     DB db(env_conn);
 
+    AuthServiceClient authService(AuthServiceOptions::fromEnv());
+    TestBundleCache bundles(db);
+    RegradeJobs regrades(env_conn);
+    AnswerStreamHub answerStream(env_conn);
+
     // Проверка активации
     CROW_ROUTE(app, "/health")([] {
         return "OK";
     });
 
-    registerRoutes(app, db);
+    // Метрики для Prometheus
+    CROW_ROUTE(app, "/metrics")([] {
+        crow::response res(200, MetricsRegistry::instance().render());
+        res.set_header("Content-Type", "text/plain; version=0.0.4");
+        return res;
+    });
+
+    registerRoutes(app, db, authService, bundles, regrades, answerStream);
 
-    app.port(18080).multithreaded().run();
+    // Число потоков задаётся явно: от него считаются пределы AdmissionMiddleware
+    app.port(18080).concurrency(coreWorkerThreads()).run();
 }
@@ -0,0 +1,172 @@
+#include "metrics.h"
+#include <cctype>
+#include <charconv>
+#include <cmath>
+
+namespace {
+
+std::string escapeLabel(std::string_view value) {
+    std::string out;
+    out.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\') out += "\\\\";
+        else if (c == '"') out += "\\\"";
+        else if (c == '\n') out += "\\n";
+        else out.push_back(c);
+    }
+    return out;
+}
+
+std::string renderLabels(const MetricLabels& labels) {
+    if (labels.empty()) return "";
+    std::string out = "{";
+    for (size_t i = 0; i < labels.size(); ++i) {
+        if (i) out.push_back(',');
+        out += labels[i].first;
+        out += "=\"";
+        out += escapeLabel(labels[i].second);
+        out.push_back('"');
+    }
+    out.push_back('}');
+    return out;
+}
+
+// Добавить метку к уже отрендеренному набору: {a="b"} + le="0.5" -> {a="b",le="0.5"}
+std::string withLabel(const std::string& labels, std::string_view extra) {
+    if (labels.empty()) return "{" + std::string(extra) + "}";
+    return labels.substr(0, labels.size() - 1) + "," + std::string(extra) + "}";
+}
+
+void appendNumber(std::string& out, double value) {
+    if (std::isnan(value)) {
+        out += "NaN";
+        return;
+    }
+    if (std::isinf(value)) {
+        out += value > 0 ? "+Inf" : "-Inf";
+        return;
+    }
+    char buf[32];
+    auto r = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::general);
+    out.append(buf, r.ptr);
+}
+
+const char* typeName(MetricsRegistry::Type type) {
+    switch (type) {
+        case MetricsRegistry::Type::Counter: return "counter";
+        case MetricsRegistry::Type::Gauge: return "gauge";
+        case MetricsRegistry::Type::Histogram: return "histogram";
+    }
+    return "untyped";
+}
+
+} // namespace
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::Series& MetricsRegistry::series(
+    std::string_view name, std::string_view help, Type type, const MetricLabels& labels
+) {
+    auto it = families.find(name);
+    if (it == families.end()) {
+        it = families.emplace(std::string(name), Family{std::string(help), type, {}}).first;
+    }
+
+    auto& family = it->second;
+    std::string key = renderLabels(labels);
+    if (family.series.size() >= kMaxSeriesPerFamily && family.series.find(key) == family.series.end()) {
+        key = renderLabels({{"overflow", "true"}});
+    }
+    return family.series[key];
+}
+
+Counter& MetricsRegistry::counter(std::string_view name, std::string_view help, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& s = series(name, help, Type::Counter, labels);
+    if (!s.counter) s.counter = std::make_unique<Counter>();
+    return *s.counter;
+}
+
+Gauge& MetricsRegistry::gauge(std::string_view name, std::string_view help, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& s = series(name, help, Type::Gauge, labels);
+    if (!s.gauge) s.gauge = std::make_unique<Gauge>();
+    return *s.gauge;
+}
+
+Histogram& MetricsRegistry::histogram(std::string_view name, std::string_view help, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& s = series(name, help, Type::Histogram, labels);
+    if (!s.histogram) s.histogram = std::make_unique<Histogram>();
+    return *s.histogram;
+}
+
+void MetricsRegistry::callback(std::string_view name, std::string_view help, Type type,
+                               const MetricLabels& labels, std::function<double()> read) {
+    std::lock_guard<std::mutex> lock(mutex);
+    series(name, help, type, labels).read = std::move(read);
+}
+
+std::string MetricsRegistry::render() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string out;
+    out.reserve(64 * 1024);
+
+    for (const auto& [name, family] : families) {
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name + " " + typeName(family.type) + "\n";
+
+        for (const auto& [labels, s] : family.series) {
+            if (s.histogram) {
+                auto counts = s.histogram->bucketCounts();
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i < counts.size(); ++i) {
+                    cumulative += counts[i];
+                    std::string le = "le=\"";
+                    if (i < Histogram::kBounds.size()) appendNumber(le, Histogram::kBounds[i]);
+                    else le += "+Inf";
+                    le.push_back('"');
+                    out += name + "_bucket" + withLabel(labels, le) + " " + std::to_string(cumulative) + "\n";
+                }
+                out += name + "_sum" + labels + " ";
+                appendNumber(out, s.histogram->sumSeconds());
+                out += "\n" + name + "_count" + labels + " " + std::to_string(cumulative) + "\n";
+                continue;
+            }
+
+            out += name + labels + " ";
+            if (s.counter) out += std::to_string(s.counter->get());
+            else if (s.gauge) out += std::to_string(s.gauge->get());
+            else if (s.read) appendNumber(out, s.read());
+            else out += "0";
+            out.push_back('\n');
+        }
+    }
+    return out;
+}
+
+std::string normalizeRoute(std::string_view url) {
+    std::string route;
+    route.reserve(url.size());
+
+    size_t pos = 0;
+    while (pos < url.size()) {
+        size_t next = url.find('/', pos + 1);
+        if (next == std::string_view::npos) next = url.size();
+        std::string_view segment = url.substr(pos, next - pos);
+
+        bool hasDigit = false;
+        for (char c : segment) {
+            if (std::isdigit(static_cast<unsigned char>(c))) {
+                hasDigit = true;
+                break;
+            }
+        }
+        route += hasDigit ? std::string_view("/<id>") : segment;
+        pos = next;
+    }
+    return route.empty() ? "/" : route;
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Метрики в формате Prometheus (text exposition 0.0.4), отдаются на /metrics.
+// Обновление счётчиков и гистограмм - только атомарные операции без блокировок.
+// Регистрация серии берёт мьютекс реестра, поэтому в горячем коде ссылку на
+// серию запоминают (static / thread_local кеш), а не ищут на каждый вызов.
+
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+class Counter {
+public:
+    void inc(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value{0};
+};
+
+class Gauge {
+public:
+    void set(int64_t v) { value.store(v, std::memory_order_relaxed); }
+    void add(int64_t n) { value.fetch_add(n, std::memory_order_relaxed); }
+    int64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value{0};
+};
+
+// Гистограмма длительностей в секундах с фиксированными границами корзин
+class Histogram {
+public:
+    static constexpr std::array<double, 14> kBounds = {
+        0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+        0.1, 0.25, 0.5, 1, 2.5, 5, 10
+    };
+
+    void observe(std::chrono::nanoseconds elapsed) {
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        size_t bucket = 0;
+        while (bucket < kBounds.size() && seconds > kBounds[bucket]) ++bucket;
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        sumNanos.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+    }
+
+    // Накопленные значения: count по корзинам (не кумулятивно), сумма в секундах
+    std::array<uint64_t, kBounds.size() + 1> bucketCounts() const {
+        std::array<uint64_t, kBounds.size() + 1> counts{};
+        for (size_t i = 0; i < counts.size(); ++i) {
+            counts[i] = buckets[i].load(std::memory_order_relaxed);
+        }
+        return counts;
+    }
+
+    double sumSeconds() const {
+        return static_cast<double>(sumNanos.load(std::memory_order_relaxed)) / 1e9;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kBounds.size() + 1> buckets{};
+    std::atomic<uint64_t> sumNanos{0};
+};
+
+// Замер времени до конца области видимости
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram* histogram)
+        : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    explicit ScopedTimer(Histogram& histogram) : ScopedTimer(&histogram) {}
+
+    ScopedTimer(ScopedTimer&& other) noexcept : histogram(other.histogram), start(other.start) {
+        other.histogram = nullptr;
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(ScopedTimer&&) = delete;
+
+    ~ScopedTimer() {
+        if (histogram) histogram->observe(std::chrono::steady_clock::now() - start);
+    }
+
+private:
+    Histogram* histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+class MetricsRegistry {
+public:
+    enum class Type { Counter, Gauge, Histogram };
+
+    // Ограничение числа серий в семействе: всё сверх него сливается в {overflow="true"}
+    static constexpr size_t kMaxSeriesPerFamily = 500;
+
+    static MetricsRegistry& instance();
+
+    Counter& counter(std::string_view name, std::string_view help, const MetricLabels& labels = {});
+    Gauge& gauge(std::string_view name, std::string_view help, const MetricLabels& labels = {});
+    Histogram& histogram(std::string_view name, std::string_view help, const MetricLabels& labels = {});
+
+    // Значение, которое считывается в момент отдачи /metrics (размер пула, hit rate кеша).
+    // Объект, из которого читает read, должен жить до конца работы сервиса.
+    void callback(std::string_view name, std::string_view help, Type type,
+                  const MetricLabels& labels, std::function<double()> read);
+
+    std::string render() const;
+
+private:
+    struct Series {
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> read;
+    };
+
+    struct Family {
+        std::string help;
+        Type type;
+        std::map<std::string, Series> series;   // ключ - отрендеренные метки {a="b",...}
+    };
+
+    Series& series(std::string_view name, std::string_view help, Type type, const MetricLabels& labels);
+
+    mutable std::mutex mutex;
+    std::map<std::string, Family, std::less<>> families;
+};
+
+// Шаблон маршрута для метки route: сегменты с цифрами заменяются на <id>,
+// чтобы /tests/12/start и /tests/13/start попадали в одну серию
+std::string normalizeRoute(std::string_view url);
+
+// Попадания и промахи кеша (TtlCache и всё, у чего есть hits()/misses())
+template <typename Cache>
+void registerCacheMetrics(const std::string& name, const Cache& cache) {
+    auto& registry = MetricsRegistry::instance();
+    MetricLabels labels = {{"cache", name}};
+    registry.callback("core_cache_hits_total", "Cache lookups served from a fresh entry",
+                      MetricsRegistry::Type::Counter, labels, [&cache] { return double(cache.hits()); });
+    registry.callback("core_cache_misses_total", "Cache lookups that missed or found an expired entry",
+                      MetricsRegistry::Type::Counter, labels, [&cache] { return double(cache.misses()); });
+    registry.callback("core_cache_hit_ratio", "Share of cache lookups served from the cache since start",
+                      MetricsRegistry::Type::Gauge, labels, [&cache] {
+                          double hits = double(cache.hits());
+                          double total = hits + double(cache.misses());
+                          return total > 0 ? hits / total : 0.0;
+                      });
+}
@@ -0,0 +1,214 @@
+#include "admission.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+constexpr std::chrono::milliseconds kWindow{500};
+constexpr int64_t kMinSamples = 20;
+// Через столько окон минимальная задержка забывается: после смены нагрузки
+// (прогрелся кеш, сменился план запроса) старый минимум держал бы предел внизу
+constexpr int kResetWindows = 120;
+
+int envInt(const char* name, int fallback) {
+    const char* value = std::getenv(name);
+    return value ? std::atoi(value) : fallback;
+}
+
+double envDouble(const char* name, double fallback) {
+    const char* value = std::getenv(name);
+    return value ? std::atof(value) : fallback;
+}
+
+int64_t nanosSinceEpoch(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+const char* priorityName(RequestPriority priority) {
+    switch (priority) {
+        case RequestPriority::Critical: return "critical";
+        case RequestPriority::Normal: return "normal";
+        case RequestPriority::Background: return "background";
+    }
+    return "normal";
+}
+
+// Доля предела, доступная классу: фоновые упираются первыми, критичным остаётся запас
+double limitShare(RequestPriority priority) {
+    switch (priority) {
+        case RequestPriority::Critical: return 1.0;
+        case RequestPriority::Normal: return 0.75;
+        case RequestPriority::Background: return 0.5;
+    }
+    return 0.75;
+}
+
+// Серии счётчика отказов создаются один раз: при перегрузке реестр с мьютексом не трогаем
+Counter& rejected(RequestPriority priority, bool dbQueue) {
+    static const auto counters = [] {
+        std::array<std::array<Counter*, 2>, 3> table{};
+        for (int p = 0; p < 3; ++p) {
+            for (int r = 0; r < 2; ++r) {
+                table[p][r] = &MetricsRegistry::instance().counter(
+                    "core_admission_rejected_total", "Requests shed with 503 by admission control",
+                    {{"priority", priorityName((RequestPriority)p)}, {"reason", r ? "db_queue" : "limit"}});
+            }
+        }
+        return table;
+    }();
+    return *counters[(int)priority][dbQueue];
+}
+
+} // namespace
+
+int coreWorkerThreads() {
+    int threads = envInt("CORE_THREADS", 0);
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    return std::max(1, threads);
+}
+
+AdmissionOptions AdmissionOptions::fromEnv(int workerThreads) {
+    AdmissionOptions options;
+    workerThreads = std::max(1, workerThreads);
+    options.enabled = envInt("ADMISSION_ENABLED", 1) != 0;
+    options.maxLimit = std::max(1, envInt("ADMISSION_MAX_LIMIT", workerThreads));
+    options.minLimit = std::clamp(envInt("ADMISSION_MIN_LIMIT", std::max(1, workerThreads / 4)), 1, options.maxLimit);
+    options.maxDbQueue = envInt("ADMISSION_MAX_DB_QUEUE", options.maxDbQueue);
+    options.latencyTolerance = std::max(1.0, envDouble("ADMISSION_LATENCY_TOLERANCE", options.latencyTolerance));
+    options.retryAfterSeconds = std::max(1, envInt("ADMISSION_RETRY_AFTER", options.retryAfterSeconds));
+    return options;
+}
+
+RequestPriority classifyRequest(crow::HTTPMethod method, std::string_view url) {
+    static const std::unordered_map<std::string, RequestPriority> routes = {
+        // Экзамен: ответы, завершение, начало попытки и её вопросы
+        {"PATCH /attempts/<id>/questions/<id>/answer", RequestPriority::Critical},
+        {"DELETE /attempts/<id>/questions/<id>/answer", RequestPriority::Critical},
+        {"POST /attempts/<id>/answers", RequestPriority::Critical},
+        {"POST /attempts/<id>/answers:batch", RequestPriority::Critical},
+        {"POST /attempts/<id>/complete", RequestPriority::Critical},
+        {"POST /tests/<id>/start", RequestPriority::Critical},
+        {"GET /attempts/<id>/bundle", RequestPriority::Critical},
+
+        // Отчёты, списки и выгрузки
+        {"GET /tests/<id>/analysis", RequestPriority::Background},
+        {"GET /tests/<id>/export", RequestPriority::Background},
+        {"GET /tests/<id>/answers", RequestPriority::Background},
+        {"GET /tests/<id>/scores", RequestPriority::Background},
+        {"GET /tests/<id>/passed-users", RequestPriority::Background},
+        {"GET /courses/<id>/students", RequestPriority::Background},
+        {"GET /courses", RequestPriority::Background},
+        {"GET /questions", RequestPriority::Background},
+        {"GET /users", RequestPriority::Background},
+        {"GET /debug/queries", RequestPriority::Background},
+        {"POST /tests/<id>/regrade", RequestPriority::Background},
+        {"POST /questions/<id>/regrade", RequestPriority::Background},
+    };
+
+    auto it = routes.find(std::string(crow::method_name(method)) + " " + normalizeRoute(url));
+    return it == routes.end() ? RequestPriority::Normal : it->second;
+}
+
+// Старт с полного числа потоков: сжимается, только если задержка действительно растёт
+AdaptiveLimiter::AdaptiveLimiter(const AdmissionOptions& options)
+    : options(options), currentLimit(options.maxLimit) {}
+
+int AdaptiveLimiter::allowed(RequestPriority priority) const {
+    int limit = currentLimit.load(std::memory_order_relaxed);
+    if (priority == RequestPriority::Critical) return limit;
+    // Некритичные никогда не занимают последний поток
+    int share = (int)(limit * limitShare(priority));
+    return std::max(1, std::min(share, limit - 1));
+}
+
+bool AdaptiveLimiter::tryAcquire(RequestPriority priority) {
+    int64_t current = active.fetch_add(1, std::memory_order_acq_rel) + 1;
+    if (current > allowed(priority)) {
+        active.fetch_sub(1, std::memory_order_acq_rel);
+        return false;
+    }
+    return true;
+}
+
+void AdaptiveLimiter::release(std::chrono::nanoseconds latency, bool sample) {
+    active.fetch_sub(1, std::memory_order_acq_rel);
+    if (!sample) return;
+
+    windowNanos.fetch_add(latency.count(), std::memory_order_relaxed);
+    windowSamples.fetch_add(1, std::memory_order_relaxed);
+
+    auto now = std::chrono::steady_clock::now();
+    if (nanosSinceEpoch(now) >= windowEnd.load(std::memory_order_relaxed)) adjust(now);
+}
+
+void AdaptiveLimiter::adjust(std::chrono::steady_clock::time_point now) {
+    std::unique_lock<std::mutex> lock(adjustMutex, std::try_to_lock);
+    if (!lock) return;
+
+    int64_t nowNanos = nanosSinceEpoch(now);
+    if (nowNanos < windowEnd.load(std::memory_order_relaxed)) return;
+    windowEnd.store(nowNanos + std::chrono::nanoseconds(kWindow).count(), std::memory_order_relaxed);
+
+    int64_t samples = windowSamples.exchange(0, std::memory_order_relaxed);
+    int64_t nanos = windowNanos.exchange(0, std::memory_order_relaxed);
+    if (samples < kMinSamples) return;
+
+    double average = (double)nanos / samples;
+    if (minLatency == 0 || average < minLatency || ++windowsSinceReset >= kResetWindows) {
+        minLatency = average;
+        windowsSinceReset = 0;
+    }
+
+    double limit = currentLimit.load(std::memory_order_relaxed);
+    double gradient = std::clamp(options.latencyTolerance * minLatency / average, 0.5, 1.0);
+    double next = limit * gradient;
+    if (gradient >= 1.0) {
+        // Растём, только если предел действительно выбирается, иначе он уйдёт в потолок без нагрузки
+        if (active.load(std::memory_order_relaxed) * 2 >= limit) next += std::sqrt(limit);
+    } else {
+        // Сжатие сглаживается, чтобы один медленный всплеск не обрушил предел
+        next = (limit + next) / 2;
+    }
+    currentLimit.store(std::clamp((int)next, options.minLimit, options.maxLimit), std::memory_order_relaxed);
+}
+
+AdmissionMiddleware::AdmissionMiddleware() {
+    auto& registry = MetricsRegistry::instance();
+    registry.callback("core_admission_limit", "Current adaptive limit of concurrent requests",
+                      MetricsRegistry::Type::Gauge, {}, [this] { return double(limiter.limit()); });
+    registry.callback("core_admission_in_flight", "Requests admitted and not yet finished",
+                      MetricsRegistry::Type::Gauge, {}, [this] { return double(limiter.inFlight()); });
+}
+
+void AdmissionMiddleware::before_handle(crow::request& req, crow::response& res, context& ctx) {
+    if (!options.enabled || req.url == "/health" || req.url == "/metrics") return;
+
+    auto priority = classifyRequest(req.method, req.url);
+    int64_t queued = dbQueue.get();
+
+    // База не успевает: фоновые отсекаются раньше, критичные проходят всегда
+    bool dbBusy = (priority == RequestPriority::Background && queued > options.maxDbQueue / 2) ||
+                  (priority == RequestPriority::Normal && queued > options.maxDbQueue);
+    if (dbBusy || !limiter.tryAcquire(priority)) {
+        rejected(priority, dbBusy).inc();
+        int retryAfter = options.retryAfterSeconds * (priority == RequestPriority::Background ? 5 : 1);
+        res.code = 503;
+        res.set_header("Retry-After", std::to_string(retryAfter));
+        res.end("Service overloaded, retry later");
+        return;
+    }
+
+    ctx.admitted = true;
+    ctx.sample = priority != RequestPriority::Background;
+    ctx.start = std::chrono::steady_clock::now();
+}
+
+void AdmissionMiddleware::after_handle(crow::request&, crow::response&, context& ctx) {
+    if (!ctx.admitted) return;
+    limiter.release(std::chrono::steady_clock::now() - ctx.start, ctx.sample);
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "crow.h"
+#include "../metrics/metrics.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+
+// Потоков Crow, обрабатывающих запросы (CORE_THREADS, по умолчанию - число ядер).
+// main задаёт его через app.concurrency(), от него же считаются пределы допуска
+int coreWorkerThreads();
+
+// Настройки допуска запросов (переопределяются переменными окружения)
+struct AdmissionOptions {
+    bool enabled = true;            // ADMISSION_ENABLED=0 отключает ограничение
+    int minLimit = 1;               // ADMISSION_MIN_LIMIT, по умолчанию четверть потоков
+    int maxLimit = 1;               // ADMISSION_MAX_LIMIT, по умолчанию число потоков
+    int maxDbQueue = 32;            // ADMISSION_MAX_DB_QUEUE, SQL в ожидании; выше - только критичные
+    double latencyTolerance = 2.0;  // ADMISSION_LATENCY_TOLERANCE, допустимый рост задержки к минимальной
+    int retryAfterSeconds = 1;      // ADMISSION_RETRY_AFTER
+
+    static AdmissionOptions fromEnv(int workerThreads = coreWorkerThreads());
+};
+
+// Критичные - то, без чего студент теряет ответы на экзамене;
+// фоновые - списки, отчёты и выгрузки, которые можно повторить позже
+enum class RequestPriority { Critical, Normal, Background };
+
+RequestPriority classifyRequest(crow::HTTPMethod method, std::string_view url);
+
+// Предел одновременных запросов, подстраиваемый по задержке (градиент как в TCP Vegas):
+// пока средняя задержка окна близка к минимальной, предел растёт на sqrt(limit),
+// при росте задержки сжимается пропорционально.
+//
+// Обработчики Crow синхронные, поэтому в обработке не бывает больше запросов, чем потоков,
+// а ожидание свободного потока (очередь в ядре и в соединениях) отсюда не видно.
+// Поэтому предел не выше числа потоков и работает как резерв потоков: обычные и фоновые
+// запросы занимают только свою долю и всегда оставляют хотя бы один поток критичным.
+// Пока потоки свободны для экзамена, очередь перед ними не растёт; когда база тормозит,
+// задержка растёт, предел сжимается и лишнее отсекается сразу, а не ждёт потока.
+class AdaptiveLimiter {
+public:
+    explicit AdaptiveLimiter(const AdmissionOptions& options);
+
+    bool tryAcquire(RequestPriority priority);
+    // Сколько запросов класса допускается при текущем пределе
+    int allowed(RequestPriority priority) const;
+    // sample - учитывать ли задержку в подстройке предела (фоновые запросы долгие сами по себе)
+    void release(std::chrono::nanoseconds latency, bool sample);
+
+    int limit() const { return currentLimit.load(std::memory_order_relaxed); }
+    int64_t inFlight() const { return active.load(std::memory_order_relaxed); }
+
+private:
+    void adjust(std::chrono::steady_clock::time_point now);
+
+    AdmissionOptions options;
+    std::atomic<int> currentLimit;
+    std::atomic<int64_t> active{0};
+
+    // Окно замеров; пересчёт предела - под try_lock, потоки Crow не ждут друг друга
+    std::atomic<int64_t> windowNanos{0};
+    std::atomic<int64_t> windowSamples{0};
+    std::atomic<int64_t> windowEnd{0};
+    std::mutex adjustMutex;
+    double minLatency = 0;      // под adjustMutex
+    int windowsSinceReset = 0;  // под adjustMutex
+};
+
+// Сброс нагрузки: сверх предела ответ 503 с Retry-After сразу, без очереди.
+// Стоит сразу после MetricsMiddleware - отказ дешевле проверки JWT и не трогает базу.
+struct AdmissionMiddleware {
+    struct context {
+        bool admitted = false;
+        bool sample = false;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    AdmissionOptions options = AdmissionOptions::fromEnv();
+    AdaptiveLimiter limiter{options};
+
+    Gauge& dbQueue = MetricsRegistry::instance().gauge(
+        "core_db_queries_in_flight", "SQL statements currently executing");
+
+    AdmissionMiddleware();
+
+    void before_handle(crow::request& req, crow::response& res, context& ctx);
+    void after_handle(crow::request& req, crow::response& res, context& ctx);
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include "crow.h"
+#include "../security/auth_guard.h"
+#include <string>
+#include <unordered_set>
+
+// Аутентификация один раз на запрос, до выбора маршрута.
+// Обработчики берут пользователя через app.get_context<AuthMiddleware>(req).user
+struct AuthMiddleware {
+    struct context {
+        UserContext user;
+    };
+
+    // Маршруты без авторизации
+    std::unordered_set<std::string> publicRoutes = {"/health", "/metrics"};
+
+    void before_handle(crow::request& req, crow::response& res, context& ctx) {
+        if (publicRoutes.count(req.url)) {
+            return;
+        }
+
+        auto auth = authGuard(req, ctx.user);
+        if (auth == 418) {
+            res.code = 403;
+            res.end("Blocked");
+        } else if (auth == 401) {
+            res.code = 401;
+            res.end("Unauthorized");
+        }
+    }
+
+    void after_handle(crow::request&, crow::response&, context&) {}
+};
@@ -0,0 +1,202 @@
+#include "compression.h"
+#include "../http/etag.h"
+#include <zlib.h>
+#include <zstd.h>
+#include <cstdlib>
+#include <string_view>
+
+namespace {
+
+int envLevel(const char* name, int fallback) {
+    const char* value = std::getenv(name);
+    return value ? std::atoi(value) : fallback;
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        char x = a[i] >= 'A' && a[i] <= 'Z' ? a[i] - 'A' + 'a' : a[i];
+        if (x != b[i]) return false;
+    }
+    return true;
+}
+
+// gzip-поток потока: deflateInit2 один раз, дальше deflateReset
+class GzipCompressor {
+public:
+    ~GzipCompressor() {
+        if (initialized) deflateEnd(&stream);
+    }
+
+    bool compress(const std::string& in, std::string& out, int level) {
+        if (initialized && currentLevel != level) {
+            deflateEnd(&stream);
+            initialized = false;
+        }
+        if (!initialized) {
+            stream = {};
+            if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+            initialized = true;
+            currentLevel = level;
+        } else if (deflateReset(&stream) != Z_OK) {
+            return false;
+        }
+
+        out.resize(deflateBound(&stream, in.size()));
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+        stream.avail_in = static_cast<uInt>(in.size());
+        stream.next_out = reinterpret_cast<Bytef*>(out.data());
+        stream.avail_out = static_cast<uInt>(out.size());
+
+        if (deflate(&stream, Z_FINISH) != Z_STREAM_END) return false;
+        out.resize(stream.total_out);
+        return true;
+    }
+
+private:
+    z_stream stream{};
+    bool initialized = false;
+    int currentLevel = 0;
+};
+
+// zstd-контекст потока
+class ZstdCompressor {
+public:
+    ZstdCompressor() : ctx(ZSTD_createCCtx()) {}
+    ~ZstdCompressor() { ZSTD_freeCCtx(ctx); }
+
+    bool compress(const std::string& in, std::string& out, int level) {
+        if (!ctx) return false;
+        out.resize(ZSTD_compressBound(in.size()));
+        size_t written = ZSTD_compressCCtx(ctx, out.data(), out.size(), in.data(), in.size(), level);
+        if (ZSTD_isError(written)) return false;
+        out.resize(written);
+        return true;
+    }
+
+private:
+    ZSTD_CCtx* ctx;
+};
+
+} // namespace
+
+CompressionOptions CompressionOptions::fromEnv() {
+    CompressionOptions options;
+    options.minBytes = (size_t)envLevel("COMPRESSION_MIN_BYTES", (int)options.minBytes);
+    options.gzipLevel = envLevel("GZIP_LEVEL", options.gzipLevel);
+    options.zstdLevel = envLevel("ZSTD_LEVEL", options.zstdLevel);
+    return options;
+}
+
+ContentEncoding negotiateEncoding(const std::string& acceptEncoding) {
+    // -1 - кодировка не названа явно; тогда действует "*", если он есть
+    double gzipQ = -1, zstdQ = -1, anyQ = -1;
+    std::string_view rest(acceptEncoding);
+
+    while (!rest.empty()) {
+        size_t comma = rest.find(',');
+        std::string_view item = rest.substr(0, comma);
+        rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+
+        size_t semi = item.find(';');
+        std::string_view name = trim(item.substr(0, semi));
+        double q = 1.0;
+        if (semi != std::string_view::npos) {
+            std::string_view param = trim(item.substr(semi + 1));
+            if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                q = std::strtod(std::string(param.substr(2)).c_str(), nullptr);
+            }
+        }
+
+        if (equalsIgnoreCase(name, "zstd")) zstdQ = q;
+        else if (equalsIgnoreCase(name, "gzip") || equalsIgnoreCase(name, "x-gzip")) gzipQ = q;
+        else if (name == "*") anyQ = q;
+    }
+
+    if (gzipQ < 0) gzipQ = anyQ;
+    if (zstdQ < 0) zstdQ = anyQ;
+
+    if (zstdQ > 0 && zstdQ >= gzipQ) return ContentEncoding::Zstd;
+    if (gzipQ > 0) return ContentEncoding::Gzip;
+    return ContentEncoding::Identity;
+}
+
+bool compressBody(ContentEncoding encoding, const std::string& in, std::string& out, int level) {
+    switch (encoding) {
+        case ContentEncoding::Gzip: {
+            thread_local GzipCompressor gzip;
+            return gzip.compress(in, out, level);
+        }
+        case ContentEncoding::Zstd: {
+            thread_local ZstdCompressor zstd;
+            return zstd.compress(in, out, level);
+        }
+        default:
+            return false;
+    }
+}
+
+namespace {
+
+const char* etagSuffix(ContentEncoding encoding) {
+    return encoding == ContentEncoding::Zstd ? "-zst" : "-gz";
+}
+
+void addVary(crow::response& res) {
+    const std::string& vary = res.get_header_value("Vary");
+    if (vary.empty()) res.set_header("Vary", "Accept-Encoding");
+    else if (vary.find("Accept-Encoding") == std::string::npos) res.set_header("Vary", vary + ", Accept-Encoding");
+}
+
+// 304 от обработчика несёт ETag без кодировки; клиенту возвращаем то значение,
+// которое он прислал (в т.ч. "-gz"/"-zst"), чтобы его кеш обновил нужное представление
+void restoreCodedETag(const crow::request& req, crow::response& res) {
+    const std::string& etag = res.get_header_value("ETag");
+    const std::string& header = req.get_header_value("If-None-Match");
+    if (etag.empty() || header.empty()) return;
+
+    std::string_view rest(header);
+    while (!rest.empty()) {
+        size_t comma = rest.find(',');
+        std::string_view item = trim(rest.substr(0, comma));
+        rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+        if (item.substr(0, 2) == "W/") item.remove_prefix(2);
+        if (item != etag && sameResourceETag(item, etag)) {
+            res.set_header("ETag", std::string(item));
+            return;
+        }
+    }
+}
+
+} // namespace
+
+void CompressionMiddleware::after_handle(crow::request& req, crow::response& res, context&) {
+    if (res.code == 304) {
+        restoreCodedETag(req, res);
+        addVary(res);
+        return;
+    }
+    if (res.body.size() < options.minBytes || res.code == 204) return;
+    if (!res.get_header_value("Content-Encoding").empty()) return;
+
+    // Ответ мог быть сжат: кеши должны различать его по Accept-Encoding, даже если сейчас ушёл как есть
+    addVary(res);
+
+    auto encoding = negotiateEncoding(req.get_header_value("Accept-Encoding"));
+    if (encoding == ContentEncoding::Identity) return;
+
+    thread_local std::string compressed;
+    int level = encoding == ContentEncoding::Zstd ? options.zstdLevel : options.gzipLevel;
+    if (!compressBody(encoding, res.body, compressed, level) || compressed.size() >= res.body.size()) return;
+
+    res.body.swap(compressed);
+    res.set_header("Content-Encoding", encoding == ContentEncoding::Zstd ? "zstd" : "gzip");
+    const std::string& etag = res.get_header_value("ETag");
+    if (!etag.empty()) res.set_header("ETag", codedETag(etag, etagSuffix(encoding)));
+}
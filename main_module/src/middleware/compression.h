@@ -0,0 +1,32 @@
+#pragma once
+#include "crow.h"
+#include <string>
+
+enum class ContentEncoding { Identity, Gzip, Zstd };
+
+// Настройки сжатия ответов (переопределяются переменными окружения)
+struct CompressionOptions {
+    size_t minBytes = 1024;     // COMPRESSION_MIN_BYTES, меньшие ответы не сжимаются
+    int gzipLevel = 6;          // GZIP_LEVEL (1-9)
+    int zstdLevel = 3;          // ZSTD_LEVEL (1-19)
+
+    static CompressionOptions fromEnv();
+};
+
+// Выбор кодировки по Accept-Encoding с учётом q-значений (при равенстве zstd лучше gzip).
+// "*" действует только на кодировки, не названные явно: "gzip;q=0, *" - это zstd, но не gzip
+ContentEncoding negotiateEncoding(const std::string& acceptEncoding);
+
+// Сжатие в out; false - сжать не удалось, тело нужно отдать как есть
+bool compressBody(ContentEncoding encoding, const std::string& in, std::string& out, int level);
+
+// Сжатие больших ответов gzip/zstd. Контексты компрессоров живут в потоке и переиспользуются.
+// Сжатое тело получает свой ETag (см. codedETag), Vary: Accept-Encoding ставится на всё, что могло сжиматься.
+struct CompressionMiddleware {
+    struct context {};
+
+    CompressionOptions options = CompressionOptions::fromEnv();
+
+    void before_handle(crow::request&, crow::response&, context&) {}
+    void after_handle(crow::request& req, crow::response& res, context&);
+};
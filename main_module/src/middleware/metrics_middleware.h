@@ -0,0 +1,63 @@
+#pragma once
+#include "crow.h"
+#include "../cache/ttl_cache.h"
+#include "../metrics/metrics.h"
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
+// Число запросов, время ответа по маршрутам и запросы в обработке.
+// Стоит первым в CoreApp, чтобы учитывать и ответы, оборванные другими middleware (401, 403).
+struct MetricsMiddleware {
+    struct context {
+        std::chrono::steady_clock::time_point start;
+    };
+
+    Gauge& inFlight = MetricsRegistry::instance().gauge(
+        "core_http_requests_in_flight", "HTTP requests currently being handled");
+
+    void before_handle(crow::request&, crow::response&, context& ctx) {
+        ctx.start = std::chrono::steady_clock::now();
+        inFlight.add(1);
+    }
+
+    void after_handle(crow::request& req, crow::response& res, context& ctx) {
+        inFlight.add(-1);
+
+        std::string method = crow::method_name(req.method);
+        std::string route = normalizeRoute(req.url);
+        latency(method, route).observe(std::chrono::steady_clock::now() - ctx.start);
+        requests(method, route, res.code).inc();
+    }
+
+private:
+    // Серии запоминаются в потоке, реестр с мьютексом трогается только для новых маршрутов
+    static Histogram& latency(const std::string& method, const std::string& route) {
+        thread_local std::unordered_map<std::string, Histogram*, StringKeyHash, std::equal_to<>> cache;
+        std::string key = method + " " + route;
+        auto it = cache.find(key);
+        if (it == cache.end()) {
+            if (cache.size() >= MetricsRegistry::kMaxSeriesPerFamily) cache.clear();
+            auto& histogram = MetricsRegistry::instance().histogram(
+                "core_http_request_duration_seconds", "HTTP request latency by route",
+                {{"method", method}, {"route", route}});
+            it = cache.emplace(std::move(key), &histogram).first;
+        }
+        return *it->second;
+    }
+
+    static Counter& requests(const std::string& method, const std::string& route, int code) {
+        thread_local std::unordered_map<std::string, Counter*, StringKeyHash, std::equal_to<>> cache;
+        std::string status = std::to_string(code);
+        std::string key = method + " " + route + " " + status;
+        auto it = cache.find(key);
+        if (it == cache.end()) {
+            if (cache.size() >= MetricsRegistry::kMaxSeriesPerFamily) cache.clear();
+            auto& counter = MetricsRegistry::instance().counter(
+                "core_http_requests_total", "HTTP requests by route and status",
+                {{"method", method}, {"route", route}, {"status", status}});
+            it = cache.emplace(std::move(key), &counter).first;
+        }
+        return *it->second;
+    }
+};
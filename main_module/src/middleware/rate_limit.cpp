@@ -0,0 +1,179 @@
+#include "rate_limit.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+
+namespace {
+
+// Ответы на экзамене: автосохранение шлёт их часто, но не десятками в секунду
+constexpr RateBudget kAnswerBudget{"answer", 10, 30};
+// Пакет ответов заменяет десятки одиночных запросов
+constexpr RateBudget kAnswerBatchBudget{"answer_batch", 2, 10};
+// Прочая запись
+constexpr RateBudget kWriteBudget{"write", 5, 20};
+
+constexpr std::array<const RateBudget*, 3> kBudgets = {&kAnswerBudget, &kAnswerBatchBudget, &kWriteBudget};
+
+// Ведро, простоявшее минуту, TokenBuckets отдаёт другому ключу: к этому времени оно должно быть полным
+static_assert(std::all_of(kBudgets.begin(), kBudgets.end(),
+                          [](const RateBudget* budget) { return budget->burst <= budget->perSecond * 60; }));
+
+// Сегмент шаблона "<id>" совпадает с любым сегментом, где есть цифра (как в normalizeRoute).
+// Без аллокаций: проверка идёт на каждый запрос записи
+bool matchRoute(std::string_view url, std::string_view pattern) {
+    while (!url.empty() && !pattern.empty()) {
+        if (url.front() != '/' || pattern.front() != '/') return false;
+        url.remove_prefix(1);
+        pattern.remove_prefix(1);
+
+        size_t u = std::min(url.find('/'), url.size());
+        size_t p = std::min(pattern.find('/'), pattern.size());
+        std::string_view segment = url.substr(0, u);
+        std::string_view expected = pattern.substr(0, p);
+
+        if (expected == "<id>") {
+            if (std::none_of(segment.begin(), segment.end(), [](char c) { return c >= '0' && c <= '9'; })) return false;
+        } else if (segment != expected) {
+            return false;
+        }
+        url.remove_prefix(u);
+        pattern.remove_prefix(p);
+    }
+    return url.empty() && pattern.empty();
+}
+
+} // namespace
+
+RateLimitOptions RateLimitOptions::fromEnv() {
+    RateLimitOptions options;
+    if (const char* value = std::getenv("RATE_LIMIT_ENABLED")) options.enabled = std::atoi(value) != 0;
+    if (const char* value = std::getenv("RATE_LIMIT_SCALE")) {
+        double scale = std::atof(value);
+        if (scale > 0) options.scale = scale;
+    }
+    return options;
+}
+
+const RateBudget* rateBudgetFor(crow::HTTPMethod method, std::string_view url) {
+    switch (method) {
+        case crow::HTTPMethod::Patch:
+        case crow::HTTPMethod::Delete:
+            if (matchRoute(url, "/attempts/<id>/questions/<id>/answer")) return &kAnswerBudget;
+            return &kWriteBudget;
+        case crow::HTTPMethod::Post:
+            if (matchRoute(url, "/attempts/<id>/answers")) return &kAnswerBudget;
+            if (matchRoute(url, "/attempts/<id>/answers:batch")) return &kAnswerBatchBudget;
+            return &kWriteBudget;
+        case crow::HTTPMethod::Put:
+            return &kWriteBudget;
+        default:
+            return nullptr;
+    }
+}
+
+uint64_t TokenBuckets::key(std::string_view userId, const RateBudget& budget) {
+    uint64_t h = std::hash<std::string_view>{}(userId);
+    return (h ^ reinterpret_cast<uintptr_t>(&budget)) * 0x9E3779B97F4A7C15ull;
+}
+
+namespace {
+
+// Слово ведра: метка (16 бит) | время в тиках по 10 мс (32 бита) | остаток в сотых токена (16 бит).
+// За тик ведро пополняется на perSecond сотых токена
+constexpr uint64_t kToken = 100;
+constexpr uint64_t kTokenMask = 0xFFFF;
+constexpr uint32_t kTickMs = 10;
+
+uint64_t bucketTag(uint64_t state) { return state >> 48; }
+uint32_t bucketStamp(uint64_t state) { return (uint32_t)(state >> 16); }
+uint64_t bucketTokens(uint64_t state) { return state & kTokenMask; }
+
+} // namespace
+
+// Отсчёт от создания таблицы, +1: нулевое слово означает ещё не тронутое ведро
+uint32_t TokenBuckets::nowTicks(std::chrono::steady_clock::time_point now) const {
+    return (uint32_t)(std::chrono::duration_cast<std::chrono::milliseconds>(now - origin).count() / kTickMs) + 1;
+}
+
+uint32_t TokenBuckets::tryTake(uint64_t key, const RateBudget& budget, std::chrono::steady_clock::time_point now) {
+    constexpr int32_t kMaxSkewTicks = 6000;
+    const uint64_t capacity = std::min<uint64_t>((uint64_t)budget.burst * kToken, kTokenMask);
+    const uint32_t tick = nowTicks(now);
+    const uint64_t tag = (key & 0xFFFF) ? (key & 0xFFFF) : 1;
+    const size_t home = (size_t)(key >> 48) % kSlots;
+
+    auto idle = [&](uint64_t state) {
+        return state == 0 || (int32_t)(tick - bucketStamp(state)) >= (int32_t)kIdleTicks;
+    };
+
+    // Слот могут занять между поиском и CAS - тогда ищем заново
+    for (size_t attempt = 0; attempt < kProbes; ++attempt) {
+        std::atomic<uint64_t>* slot = nullptr;
+        uint64_t state = 0;
+        for (size_t i = 0; i < kProbes; ++i) {
+            auto& candidate = slots[(home + i) % kSlots];
+            uint64_t current = candidate.load(std::memory_order_relaxed);
+            if (bucketTag(current) == tag) {
+                slot = &candidate;
+                state = current;
+                break;
+            }
+            if (!slot && idle(current)) {
+                slot = &candidate;
+                state = current;
+            }
+        }
+        if (!slot) return 0;
+
+        while (bucketTag(state) == tag || idle(state)) {
+            uint64_t available = capacity;
+            uint32_t stamp = tick;
+            if (bucketTag(state) == tag) {
+                // Поток мог взять время чуть раньше того, кто успел записать ведро: время не откатываем
+                // и ничего не начисляем. Большая "отрицательная" разность - переполнение после долгого простоя
+                uint32_t elapsed = tick - bucketStamp(state);
+                int32_t skew = (int32_t)elapsed;
+                if (skew < 0 && skew > -kMaxSkewTicks) {
+                    elapsed = 0;
+                    stamp = bucketStamp(state);
+                }
+                available = std::min(capacity, bucketTokens(state) + (uint64_t)elapsed * budget.perSecond);
+            }
+            if (available < kToken) {
+                uint64_t ticks = (kToken - available + budget.perSecond - 1) / budget.perSecond;
+                return (uint32_t)(ticks * kTickMs);
+            }
+            uint64_t next = (tag << 48) | ((uint64_t)stamp << 16) | (available - kToken);
+            if (slot->compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                return 0;
+            }
+        }
+    }
+    return 0;
+}
+
+RateBudget RateLimitMiddleware::scaledBudget(const RateBudget& budget) const {
+    if (options.scale == 1.0) return budget;
+    return {
+        budget.name,
+        std::max<uint32_t>(1, (uint32_t)(budget.perSecond * options.scale)),
+        std::max<uint32_t>(1, (uint32_t)(budget.burst * options.scale)),
+    };
+}
+
+// Серии создаются один раз на бюджет
+Counter& RateLimitMiddleware::limited(const RateBudget& budget) {
+    static const auto counters = [] {
+        std::array<Counter*, kBudgets.size()> table{};
+        for (size_t i = 0; i < kBudgets.size(); ++i) {
+            table[i] = &MetricsRegistry::instance().counter(
+                "core_rate_limited_total", "Write requests rejected with 429 by per-user rate limits",
+                {{"route", kBudgets[i]->name}});
+        }
+        return table;
+    }();
+    for (size_t i = 0; i < kBudgets.size(); ++i) {
+        if (kBudgets[i] == &budget) return *counters[i];
+    }
+    return *counters.back();
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "crow.h"
+#include "auth_middleware.h"
+#include "../metrics/metrics.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+// Бюджет маршрута: устойчивый темп и запас для всплеска, в запросах
+struct RateBudget {
+    const char* name;       // метка route в метриках
+    uint32_t perSecond;
+    uint32_t burst;
+};
+
+// Настройки ограничения частоты (переопределяются переменными окружения)
+struct RateLimitOptions {
+    bool enabled = true;    // RATE_LIMIT_ENABLED=0 отключает ограничение
+    double scale = 1.0;     // RATE_LIMIT_SCALE, множитель всех бюджетов
+
+    static RateLimitOptions fromEnv();
+};
+
+// Ведра токенов в фиксированной таблице без блокировок: состояние ведра -
+// одно 64-битное слово (метка ключа, время последнего пополнения в тиках по 10 мс
+// и остаток в сотых токена), обновляется CAS. Ключ - хеш (пользователь, бюджет):
+// старшие биты выбирают начало окна из kProbes слотов, младшие дают метку.
+// Ключ ищет слот со своей меткой, иначе занимает пустой или простаивающий kIdleTicks
+// (такое ведро уже полное, его владелец ничего не теряет). Смена владельца и списание -
+// один CAS, поэтому чужое ведро не делится; общим оно становится только при совпадении
+// 16-битной метки в одном окне. Если всё окно занято активными ключами, запрос пропускается.
+class TokenBuckets {
+public:
+    // 0 - запрос разрешён, иначе - через сколько мс появится токен
+    uint32_t tryTake(uint64_t key, const RateBudget& budget, std::chrono::steady_clock::time_point now);
+
+    static uint64_t key(std::string_view userId, const RateBudget& budget);
+
+private:
+    static constexpr size_t kSlots = 1 << 16;
+    static constexpr size_t kProbes = 8;
+    static constexpr uint32_t kIdleTicks = 6000;    // минута: любой бюджет за это время наполняется
+
+    uint32_t nowTicks(std::chrono::steady_clock::time_point now) const;
+
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    std::array<std::atomic<uint64_t>, kSlots> slots{};
+};
+
+// Бюджет для запроса; nullptr - маршрут не ограничивается (чтение)
+const RateBudget* rateBudgetFor(crow::HTTPMethod method, std::string_view url);
+
+// Ограничение частоты записи по пользователю из JWT: ответ 429 с Retry-After
+// до обращения к базе. Стоит после AuthMiddleware и берёт пользователя из его контекста.
+struct RateLimitMiddleware {
+    struct context {};
+
+    RateLimitOptions options = RateLimitOptions::fromEnv();
+    TokenBuckets buckets;
+
+    template <typename AllContext>
+    void before_handle(crow::request& req, crow::response& res, context&, AllContext& all) {
+        if (!options.enabled) return;
+        const auto& user = all.template get<AuthMiddleware>().user;
+        if (user.userId.empty()) return;
+
+        const RateBudget* budget = rateBudgetFor(req.method, req.url);
+        if (!budget) return;
+
+        RateBudget scaled = scaledBudget(*budget);
+        uint32_t waitMs = buckets.tryTake(TokenBuckets::key(user.userId, *budget), scaled,
+                                          std::chrono::steady_clock::now());
+        if (waitMs == 0) return;
+
+        limited(*budget).inc();
+        res.code = 429;
+        res.set_header("Retry-After", std::to_string((waitMs + 999) / 1000));
+        res.end("Too many requests");
+    }
+
+    template <typename AllContext>
+    void after_handle(crow::request&, crow::response&, context&, AllContext&) {}
+
+private:
+    RateBudget scaledBudget(const RateBudget& budget) const;
+    static Counter& limited(const RateBudget& budget);
+};
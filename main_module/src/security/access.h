@@ -1,45 +1,37 @@
 #pragma once
 #include "user_context.h"
+#include <functional>
 #include <string>
 
 // Проверка прав
 
 struct PermissionRule {
-    std::string permission;
+    Permission permission;
     bool defaultAllowed = false;
     std::function<bool(const UserContext&, std::string)> checkDefault;
 };
 
-inline crow::response checkAccess(
+// Возвращает HTTP-код: 200 - доступ есть, 403 - нет
+inline int checkAccess(
     const UserContext& ctx,
     const PermissionRule& rule,
-    std::string resourceOwnerId
+    const std::string& resourceOwnerId
 ) {
     if (ctx.blocked) {
-        return crow::response(403);
+        return 403;
     }
-    if (ctx.permissions.find(rule.permission) != ctx.permissions.end()) {
-        return crow::response(200);
+    if (ctx.has(rule.permission)) {
+        return 200;
     }
-    if (rule.checkDefault && rule.checkDefault(ctx, resourceOwnerId)) {
-        return crow::response(200);
+    if (rule.checkDefault) {
+        return rule.checkDefault(ctx, resourceOwnerId) ? 200 : 403;
     }
-    if (rule.defaultAllowed) {
-        if (!rule.checkDefault) {
-            return crow::response(200);
-        }
-        return rule.checkDefault(ctx, resourceOwnerId) ? crow::response(200) : crow::response(403);
-    }
-    return crow::response(403);
+    return rule.defaultAllowed ? 200 : 403;
 }
 
 inline bool hasPermission(
     const UserContext& ctx,
-    const std::string& permission,
-    std::string resourceOwnerId
+    Permission permission
 ) {
-    PermissionRule rule;
-    rule.permission = permission;
-    rule.defaultAllowed = false;
-    return checkAccess(ctx, rule, resourceOwnerId).code == 200;
+    return !ctx.blocked && ctx.has(permission);
 }
@@ -4,12 +4,10 @@
 
 // Проверка JWT
 
-inline int authGuard(
-    const crow::request& req,
-    UserContext& ctx
-) {
+template <typename Verify>
+inline int authGuardWith(Verify&& verify, UserContext& ctx) {
     try {
-        ctx = parseAndVerifyJWT(req);
+        ctx = verify();
 
         if (ctx.blocked) {
             return 418;
@@ -19,4 +17,16 @@ inline int authGuard(
     } catch (...) {
         return 401;
     }
-}
\ No newline at end of file
+}
+
+inline int authGuard(
+    const crow::request& req,
+    UserContext& ctx
+) {
+    return authGuardWith([&] { return parseAndVerifyJWT(req); }, ctx);
+}
+
+// То же для токена, переданного не в Authorization
+inline int authGuardToken(std::string_view token, UserContext& ctx) {
+    return authGuardWith([&] { return verifyJWT(token); }, ctx);
+}
@@ -1,46 +1,166 @@
 #include "jwt.h"
+#include "../cache/ttl_cache.h"
+#include "../metrics/metrics.h"
 #include <jwt-cpp/jwt.h>
+#include <openssl/core_names.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <string>
+#include <string_view>
 
 // Реализация проверки JWT
 
-UserContext parseAndVerifyJWT(const crow::request& req) {
-    const char* env_secret = std::getenv("JWT_SECRET_KEY");
+namespace {
+
+constexpr auto kLeeway = std::chrono::seconds(10);
+constexpr auto kMaxCacheTtl = std::chrono::minutes(5);
+constexpr size_t kTokenCacheSize = 8192;
+
+std::string jwtSecret;
+bool jwtReady = false;
+
+// Проверенные токены -> контекст пользователя (до истечения exp)
+TtlCache<std::string, UserContext, StringKeyHash>& tokenCache() {
+    static TtlCache<std::string, UserContext, StringKeyHash> cache(kTokenCacheSize, kMaxCacheTtl);
+    return cache;
+}
+
+// HMAC-SHA256 контекст, переиспользуемый в пределах потока
+class HmacContext {
+public:
+    HmacContext() {
+        EVP_MAC* mac = EVP_MAC_fetch(nullptr, "HMAC", nullptr);
+        ctx = mac ? EVP_MAC_CTX_new(mac) : nullptr;
+        EVP_MAC_free(mac);
+    }
+    ~HmacContext() {
+        EVP_MAC_CTX_free(ctx);
+    }
+    HmacContext(const HmacContext&) = delete;
+    HmacContext& operator=(const HmacContext&) = delete;
+
+    bool sign(std::string_view data, unsigned char* out, size_t& outLen) {
+        if (!ctx) return false;
+        char digest[] = "SHA256";
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+            OSSL_PARAM_construct_end()
+        };
+        return EVP_MAC_init(ctx, reinterpret_cast<const unsigned char*>(jwtSecret.data()), jwtSecret.size(), params)
+            && EVP_MAC_update(ctx, reinterpret_cast<const unsigned char*>(data.data()), data.size())
+            && EVP_MAC_final(ctx, out, &outLen, EVP_MAX_MD_SIZE);
+    }
+
+private:
+    EVP_MAC_CTX* ctx;
+};
+
+// base64url без паддинга, как его кодирует auth-сервис
+size_t base64UrlEncode(const unsigned char* in, size_t len, char* out) {
+    static constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    size_t o = 0;
+    size_t i = 0;
+    for (; i + 2 < len; i += 3) {
+        uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        out[o++] = alphabet[(v >> 18) & 63];
+        out[o++] = alphabet[(v >> 12) & 63];
+        out[o++] = alphabet[(v >> 6) & 63];
+        out[o++] = alphabet[v & 63];
+    }
+    if (i < len) {
+        uint32_t v = in[i] << 16;
+        if (i + 1 < len) v |= in[i + 1] << 8;
+        out[o++] = alphabet[(v >> 18) & 63];
+        out[o++] = alphabet[(v >> 12) & 63];
+        if (i + 1 < len) out[o++] = alphabet[(v >> 6) & 63];
+    }
+    return o;
+}
+
+// Проверка подписи HS256 без декодирования токена
+bool verifySignature(std::string_view token) {
+    size_t sigPos = token.rfind('.');
+    if (sigPos == std::string_view::npos || token.find('.') == sigPos) return false;
+
+    thread_local HmacContext hmac;
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    size_t macLen = 0;
+    if (!hmac.sign(token.substr(0, sigPos), mac, macLen)) return false;
 
+    char expected[(EVP_MAX_MD_SIZE + 2) / 3 * 4];
+    size_t expectedLen = base64UrlEncode(mac, macLen, expected);
+
+    std::string_view signature = token.substr(sigPos + 1);
+    return signature.size() == expectedLen
+        && CRYPTO_memcmp(signature.data(), expected, expectedLen) == 0;
+}
+
+} // namespace
+
+bool initJWT() {
+    const char* env_secret = std::getenv("JWT_SECRET_KEY");
     if (!env_secret) {
-        throw std::runtime_error("JWT_SECRET_KEY is not defined in environment");
+        return false;
     }
-    
-    std::string jwt_secret(env_secret);
+    jwtSecret = env_secret;
+    jwtReady = true;
+    registerCacheMetrics("jwt_token", tokenCache());
+    return true;
+}
 
-    auto auth = req.get_header_value("Authorization");
+UserContext parseAndVerifyJWT(const crow::request& req) {
+    const std::string& auth = req.get_header_value("Authorization");
     if (auth.rfind("Bearer ", 0) != 0) {
         throw std::runtime_error("No token");
     }
+    return verifyJWT(std::string_view(auth).substr(7));
+}
+
+UserContext verifyJWT(std::string_view token) {
+    if (!jwtReady) {
+        throw std::runtime_error("JWT_SECRET_KEY is not defined in environment");
+    }
+
+    if (auto cached = tokenCache().get(token)) {
+        return std::move(*cached);
+    }
+
+    if (!verifySignature(token)) {
+        throw std::runtime_error("Token expired or invalid: signature verification failed");
+    }
 
-    std::string token = auth.substr(7);
     try {
-        auto decoded = jwt::decode(token);
+        auto decoded = jwt::decode(std::string(token));
+
+        auto now = std::chrono::system_clock::now();
+        std::chrono::steady_clock::duration ttl = kMaxCacheTtl;
+        if (decoded.has_expires_at()) {
+            auto expiresAt = decoded.get_expires_at() + kLeeway;
+            if (now >= expiresAt) {
+                throw std::runtime_error("token expired");
+            }
+            ttl = std::min(ttl, std::chrono::duration_cast<std::chrono::steady_clock::duration>(expiresAt - now));
+        }
+        if (decoded.has_not_before() && now + kLeeway < decoded.get_not_before()) {
+            throw std::runtime_error("token not yet valid");
+        }
 
-        jwt::verify()
-            .allow_algorithm(jwt::algorithm::hs256{jwt_secret})
-            .leeway(10)
-            .verify(decoded);
-        
         UserContext ctx;
 
         ctx.userId = decoded.get_payload_claim("user_id").as_string();
         ctx.blocked = decoded.get_payload_claim("blocked").as_boolean();
 
         for (auto& p : decoded.get_payload_claim("permissions").as_array()) {
-            ctx.permissions.insert(p.get<std::string>());
+            ctx.permissions |= permissionBit(p.get<std::string>());
         }
 
+        tokenCache().put(std::string(token), ctx, ttl);
         return ctx;
-    } catch (const jwt::error::token_verification_exception& e) {
-        throw std::runtime_error("Token expired or invalid: " + std::string(e.what()));
     } catch (const std::exception& e) {
         throw std::runtime_error("Auth error: " + std::string(e.what()));
     }
-}
\ No newline at end of file
+}
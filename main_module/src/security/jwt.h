@@ -1,5 +1,12 @@
-#pragma ince
+#pragma once
 #include "user_context.h"
 #include <crow.h>
+#include <string_view>
 
-UserContext parseAndVerifyJWT(const crow::request& req);
\ No newline at end of file
+// Загрузка секрета и подготовка проверки JWT (один раз при старте)
+bool initJWT();
+
+// Токен из заголовка "Authorization: Bearer <token>"
+UserContext parseAndVerifyJWT(const crow::request& req);
+// Сам токен, полученный иначе (например, при подключении WebSocket)
+UserContext verifyJWT(std::string_view token);
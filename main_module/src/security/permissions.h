@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Каталог прав (совпадает с auth_module/internal/models/permissions.go).
+// Индекс в массиве - номер бита в PermissionMask.
+
+using PermissionMask = std::uint64_t;
+
+inline constexpr std::array<std::string_view, 32> kPermissionNames = {
+    // Пользователи
+    "user:list:read",
+    "user:fullName:write",
+    "user:data:read",
+    "user:roles:read",
+    "user:roles:write",
+    "user:block:read",
+    "user:block:write",
+
+    // Курсы
+    "course:info:write",
+    "course:testList",
+    "course:test:read",
+    "course:test:write",
+    "course:test:add",
+    "course:test:del",
+    "course:userList",
+    "course:user:add",
+    "course:user:del",
+    "course:add",
+    "course:del",
+
+    // Вопросы
+    "quest:list:read",
+    "quest:read",
+    "quest:update",
+    "quest:create",
+    "quest:del",
+
+    // Тесты
+    "test:quest:del",
+    "test:quest:add",
+    "test:quest:update",
+    "test:answer:read",
+    "test:regrade",
+
+    // Ответы
+    "answer:read",
+    "answer:update",
+    "answer:del",
+
+    // Служебное
+    "debug:read",
+};
+
+static_assert(kPermissionNames.size() <= sizeof(PermissionMask) * 8, "PermissionMask is too narrow");
+
+// Бит права по имени, 0 - неизвестное право (права из JWT, которых core не знает)
+constexpr PermissionMask permissionBit(std::string_view name) {
+    for (size_t i = 0; i < kPermissionNames.size(); ++i) {
+        if (kPermissionNames[i] == name) {
+            return PermissionMask{1} << i;
+        }
+    }
+    return 0;
+}
+
+// Право, проверенное при компиляции: Permission{"quest:del"}.
+// Неизвестное имя - ошибка компиляции.
+struct Permission {
+    PermissionMask mask;
+
+    consteval Permission(const char* name) : mask(permissionBit(name)) {
+        if (mask == 0) {
+            throw "unknown permission name";
+        }
+    }
+};
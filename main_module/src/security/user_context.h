@@ -1,4 +1,5 @@
 #pragma once
+#include "permissions.h"
 #include <string>
 #include <vector>
 #include <unordered_set>
@@ -6,6 +7,10 @@
 struct UserContext {
     std::string userId;
     bool blocked;
-    std::unordered_set<std::string> permissions;
+    PermissionMask permissions = 0;
     std::unordered_set<std::string> roles;
-};
\ No newline at end of file
+
+    bool has(Permission permission) const {
+        return (permissions & permission.mask) != 0;
+    }
+};
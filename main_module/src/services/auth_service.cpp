@@ -0,0 +1,492 @@
+#include "auth_service.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <optional>
+#include <thread>
+#include <unordered_set>
+
+namespace {
+
+constexpr size_t kMaxIdleSessions = 32;
+constexpr size_t kCacheSize = 4096;
+constexpr size_t kBatchSize = 500;
+// Сколько не пробовать get_users_info после 404/405 (auth-сервис могли обновить)
+constexpr auto kBatchRetryInterval = std::chrono::minutes(5);
+// Поштучный запрос вместо пакетного: не больше стольких пользователей на один вызов
+constexpr size_t kMaxSingleLookups = 200;
+
+constexpr auto kUserInfoTtl = std::chrono::seconds(60);
+constexpr auto kRolesTtl = std::chrono::seconds(30);
+constexpr auto kBlockStatusTtl = std::chrono::seconds(10);
+
+const char* const kEndpoints[] = {
+    "/userservice/get_user_list",
+    "/userservice/get_user_info",
+    "/userservice/get_users_info",
+    "/userservice/get_user_roles",
+    "/userservice/get_user_block_status",
+    "/userservice/update_full_name",
+    "/userservice/update_user_roles",
+    "/userservice/set_block_status",
+};
+
+// Ошибка сети или 5xx - повод для автомата защиты
+bool isFailure(const AuthServiceResponse& res) {
+    return res.status == 0 || res.status >= 500;
+}
+
+AuthServiceResponse unavailable(const char* reason) {
+    return {503, std::string("Auth-service unavailable: ") + reason};
+}
+
+long envNumber(const char* name, long fallback) {
+    const char* value = std::getenv(name);
+    return value ? std::strtol(value, nullptr, 10) : fallback;
+}
+
+// Результат дублированного GET: побеждает первый успешный ответ
+struct HedgeState {
+    std::mutex mutex;
+    std::condition_variable done;
+    std::optional<AuthServiceResponse> result;
+    int pending = 0;
+};
+
+std::string userCommand(const std::string& userId) {
+    crow::json::wvalue cmd;
+    cmd["user_id"] = userId;
+    return cmd.dump();
+}
+
+} // namespace
+
+AuthServiceOptions AuthServiceOptions::fromEnv() {
+    AuthServiceOptions options;
+    if (const char* base = std::getenv("AUTH_BASE")) options.baseUrl = base;
+    options.timeout = std::chrono::milliseconds(envNumber("AUTH_TIMEOUT_MS", options.timeout.count()));
+    options.hedgeDelay = std::chrono::milliseconds(envNumber("AUTH_HEDGE_MS", options.hedgeDelay.count()));
+    options.hedgeThreads = (int)envNumber("AUTH_HEDGE_THREADS", options.hedgeThreads);
+    options.maxConcurrent = (int)envNumber("AUTH_MAX_CONCURRENCY", options.maxConcurrent);
+    return options;
+}
+
+// Взять сессию из пула (или создать новую)
+SessionPool::Lease SessionPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!idle.empty()) {
+            auto session = std::move(idle.back());
+            idle.pop_back();
+            leased.fetch_add(1, std::memory_order_relaxed);
+            return Lease(*this, std::move(session));
+        }
+    }
+    leased.fetch_add(1, std::memory_order_relaxed);
+
+    auto session = std::make_unique<cpr::Session>();
+    session->SetHeader(cpr::Header{{"Content-Type", "application/json"}, {"Connection", "keep-alive"}});
+    session->SetTimeout(cpr::Timeout{timeout});
+    return Lease(*this, std::move(session));
+}
+
+// Вернуть сессию в пул, лишние закрываются
+void SessionPool::release(std::unique_ptr<cpr::Session> session) {
+    leased.fetch_sub(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (idle.size() < maxIdle) {
+        idle.push_back(std::move(session));
+    }
+}
+
+size_t SessionPool::idleCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return idle.size();
+}
+
+HedgeExecutor::HedgeExecutor(size_t threads) {
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) workers.emplace_back(&HedgeExecutor::workerLoop, this);
+}
+
+HedgeExecutor::~HedgeExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+bool HedgeExecutor::tryRun(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping || idleWorkers <= tasks.size()) return false;
+        tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+    return true;
+}
+
+void HedgeExecutor::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        ++idleWorkers;
+        wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+        --idleWorkers;
+        if (tasks.empty()) return;
+
+        auto task = std::move(tasks.back());
+        tasks.pop_back();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+AuthServiceClient::AuthServiceClient(AuthServiceOptions options)
+    : options(std::move(options)),
+      sessions(kMaxIdleSessions, this->options.timeout),
+      userInfoCache(kCacheSize, kUserInfoTtl),
+      rolesCache(kCacheSize, kRolesTtl),
+      blockStatusCache(kCacheSize, kBlockStatusTtl),
+      hedges((size_t)std::max(0, this->options.hedgeThreads)) {
+    for (const char* endpoint : kEndpoints) {
+        breakers.emplace(endpoint, std::make_unique<CircuitBreaker>(
+            this->options.failureThreshold, this->options.openTime, this->options.maxConcurrent));
+    }
+    registerMetrics();
+}
+
+void AuthServiceClient::registerMetrics() {
+    auto& registry = MetricsRegistry::instance();
+    for (const char* endpoint : kEndpoints) {
+        auto result = [&](const char* value) {
+            return &registry.counter("core_auth_service_requests_total",
+                "Auth-service calls by endpoint and result (ok, failed, rejected by the breaker)",
+                {{"endpoint", endpoint}, {"result", value}});
+        };
+        endpointMetrics.emplace(endpoint, EndpointMetrics{
+            &registry.histogram("core_auth_service_request_duration_seconds",
+                "Auth-service call latency by endpoint", {{"endpoint", endpoint}}),
+            result("ok"),
+            result("failed"),
+            result("rejected"),
+        });
+
+        auto* breaker = breakers.at(endpoint).get();
+        registry.callback("core_auth_service_in_flight", "Auth-service calls in progress by endpoint",
+            MetricsRegistry::Type::Gauge, {{"endpoint", endpoint}},
+            [breaker] { return double(breaker->concurrency()); });
+        registry.callback("core_auth_service_circuit_open", "1 if the endpoint circuit breaker is not closed",
+            MetricsRegistry::Type::Gauge, {{"endpoint", endpoint}},
+            [breaker] { return breaker->state() == CircuitBreaker::State::Closed ? 0.0 : 1.0; });
+    }
+
+    registry.callback("core_auth_service_sessions", "Keep-alive sessions to the auth service",
+        MetricsRegistry::Type::Gauge, {{"state", "idle"}}, [this] { return double(sessions.idleCount()); });
+    registry.callback("core_auth_service_sessions", "Keep-alive sessions to the auth service",
+        MetricsRegistry::Type::Gauge, {{"state", "in_use"}}, [this] { return double(sessions.leasedCount()); });
+
+    registerCacheMetrics("auth_user_info", userInfoCache);
+    registerCacheMetrics("auth_roles", rolesCache);
+    registerCacheMetrics("auth_block_status", blockStatusCache);
+}
+
+// Запрос через автомат защиты метода
+AuthServiceResponse AuthServiceClient::send(Method method, const std::string& path, std::string body) {
+    auto& breaker = *breakers.at(path);
+    auto& metrics = endpointMetrics.at(path);
+    if (!breaker.tryAcquire()) {
+        metrics.rejected->inc();
+        return unavailable("too many concurrent requests");
+    }
+    if (!breaker.allow()) {
+        breaker.release();
+        metrics.rejected->inc();
+        return unavailable("circuit open");
+    }
+
+    ScopedTimer timer(metrics.latency);
+    AuthServiceResponse res;
+    if (method == Method::Get && options.hedgeDelay.count() > 0) {
+        res = hedgedGet(breaker, path, std::move(body));
+    } else {
+        res = perform(method, path, body);
+        breaker.release();
+    }
+
+    if (isFailure(res)) {
+        breaker.onFailure();
+        metrics.failed->inc();
+    } else {
+        breaker.onSuccess();
+        metrics.ok->inc();
+    }
+    return res;
+}
+
+// Сам HTTP-запрос через сессию из пула
+AuthServiceResponse AuthServiceClient::perform(Method method, const std::string& path, const std::string& body) {
+    auto session = sessions.acquire();
+    session->SetUrl(cpr::Url{options.baseUrl + path});
+    session->SetBody(cpr::Body{body});
+
+    cpr::Response r;
+    switch (method) {
+        case Method::Get: r = session->Get(); break;
+        case Method::Post: r = session->Post(); break;
+        case Method::Patch: r = session->Patch(); break;
+    }
+
+    if (r.error) {
+        std::cerr << "Auth-service request " << path << " failed: " << r.error.message << std::endl;
+    }
+    return {r.status_code, std::move(r.text)};
+}
+
+// GET, который дублируется, если ответа нет дольше hedgeDelay.
+// Оба запроса идут на потоках hedges; слот первого уже занят вызывающим, дубль занимает свой
+// (или не запускается). Каждая задача освобождает свой слот сам, поэтому проигравший запрос
+// досчитывается в лимите. Нет свободного потока - запрос без дубля на потоке вызывающего.
+AuthServiceResponse AuthServiceClient::hedgedGet(CircuitBreaker& breaker, const std::string& path, std::string body) {
+    auto state = std::make_shared<HedgeState>();
+
+    auto launch = [this, &breaker, &path, &body, &state] {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            ++state->pending;
+        }
+        bool started = hedges.tryRun([this, &breaker, path, body, state] {
+            auto res = perform(Method::Get, path, body);
+            breaker.release();
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            --state->pending;
+            if (!state->result || (isFailure(*state->result) && !isFailure(res))) {
+                state->result = std::move(res);
+            }
+            state->done.notify_all();
+        });
+        if (!started) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            --state->pending;
+        }
+        return started;
+    };
+
+    auto finished = [&state] {
+        return (state->result && !isFailure(*state->result)) || state->pending == 0;
+    };
+
+    if (!launch()) {
+        auto res = perform(Method::Get, path, body);
+        breaker.release();
+        return res;
+    }
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    if (!state->done.wait_for(lock, options.hedgeDelay, finished)) {
+        lock.unlock();
+        if (breaker.tryAcquire() && !launch()) {
+            breaker.release();
+        }
+        lock.lock();
+        state->done.wait(lock, finished);
+    }
+    return *state->result;
+}
+
+// GET с кешированием успешных ответов по userId
+AuthServiceResponse AuthServiceClient::cachedGet(ResponseCache& cache, const std::string& path, const std::string& userId) {
+    if (auto cached = cache.get(userId)) {
+        return {200, std::move(*cached)};
+    }
+
+    auto res = send(Method::Get, path, userCommand(userId));
+    if (res.ok()) {
+        cache.put(userId, res.body);
+    } else if (isFailure(res)) {
+        if (auto stale = cache.getStale(userId, options.maxStale)) {
+            return {200, std::move(*stale)};
+        }
+    }
+    return res;
+}
+
+AuthServiceResponse AuthServiceClient::getUserList() {
+    return send(Method::Get, "/userservice/get_user_list", "");
+}
+
+AuthServiceResponse AuthServiceClient::getUserInfo(const std::string& userId) {
+    return cachedGet(userInfoCache, "/userservice/get_user_info", userId);
+}
+
+AuthServiceResponse AuthServiceClient::getUserRoles(const std::string& userId) {
+    return cachedGet(rolesCache, "/userservice/get_user_roles", userId);
+}
+
+AuthServiceResponse AuthServiceClient::getBlockStatus(const std::string& userId) {
+    return cachedGet(blockStatusCache, "/userservice/get_user_block_status", userId);
+}
+
+// Пакетный запрос: кеш, затем get_users_info частями по kBatchSize.
+// Ожидаемый контракт: POST {"user_ids": [...]} -> {"users": [<как get_user_info>, ...]}.
+// Если auth-сервис не знает пакетного метода (404/405) - по одному, см. lookupEach;
+// это запоминается на kBatchRetryInterval, чтобы не слать заведомо неудачный POST.
+std::unordered_map<std::string, std::string> AuthServiceClient::getUsersInfo(const std::vector<std::string>& userIds) {
+    std::unordered_map<std::string, std::string> result;
+    std::vector<std::string> missing;
+    std::unordered_set<std::string> seen;
+
+    for (const auto& id : userIds) {
+        if (!seen.insert(id).second) continue;
+        if (auto cached = userInfoCache.get(id)) {
+            result.emplace(id, std::move(*cached));
+        } else {
+            missing.push_back(id);
+        }
+    }
+
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    if (now < batchUnsupportedUntil.load(std::memory_order_relaxed)) {
+        lookupEach(std::move(missing), result);
+        return result;
+    }
+
+    for (size_t offset = 0; offset < missing.size(); offset += kBatchSize) {
+        size_t end = std::min(missing.size(), offset + kBatchSize);
+        std::vector<std::string> chunk(missing.begin() + offset, missing.begin() + end);
+
+        crow::json::wvalue cmd;
+        cmd["user_ids"] = chunk;
+        auto res = send(Method::Post, "/userservice/get_users_info", cmd.dump());
+
+        if (res.ok()) {
+            auto data = crow::json::load(res.body);
+            if (!data || !data.has("users") || data["users"].t() != crow::json::type::List) {
+                continue;
+            }
+            for (const auto& user : data["users"]) {
+                if (user.t() != crow::json::type::Object || !user.has("user_id")) continue;
+                std::string id = user["user_id"].s();
+                std::string body = crow::json::wvalue(user).dump();
+                userInfoCache.put(id, body);
+                result.emplace(std::move(id), std::move(body));
+            }
+        } else if (res.status == 404 || res.status == 405) {
+            auto retryAt = std::chrono::steady_clock::now() + kBatchRetryInterval;
+            batchUnsupportedUntil.store(retryAt.time_since_epoch().count(), std::memory_order_relaxed);
+            lookupEach(std::vector<std::string>(missing.begin() + offset, missing.end()), result);
+            break;
+        } else if (isFailure(res)) {
+            for (const auto& id : chunk) {
+                if (auto stale = userInfoCache.getStale(id, options.maxStale)) {
+                    result.emplace(id, std::move(*stale));
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+// Поштучный get_user_info для тех, кого нет в кеше. Запросы идут параллельно: вызывающий поток
+// и до maxConcurrent - 1 потоков hedges берут id из общего списка (больше автомат метода не пропустит).
+// Время ограничено одним timeout, число id - kMaxSingleLookups; не успевшие получают
+// устаревшие данные из кеша, если есть, иначе в результат не попадают.
+void AuthServiceClient::lookupEach(std::vector<std::string> ids, std::unordered_map<std::string, std::string>& result) {
+    struct Lookup {
+        std::vector<std::string> ids;
+        std::chrono::steady_clock::time_point deadline;
+        std::atomic<size_t> next{0};
+
+        std::mutex mutex;
+        std::condition_variable done;
+        int running = 0;
+        std::unordered_map<std::string, std::string> found;
+    };
+
+    if (ids.empty()) return;
+    auto lookup = std::make_shared<Lookup>();
+    size_t limit = std::min(ids.size(), kMaxSingleLookups);
+    lookup->ids.assign(std::make_move_iterator(ids.begin()), std::make_move_iterator(ids.begin() + limit));
+    lookup->deadline = std::chrono::steady_clock::now() + options.timeout;
+
+    auto work = [this, lookup] {
+        size_t i;
+        while (std::chrono::steady_clock::now() < lookup->deadline
+               && (i = lookup->next.fetch_add(1, std::memory_order_relaxed)) < lookup->ids.size()) {
+            // Тело вставляется в ответ как есть, поэтому проверяем, что это JSON
+            auto single = getUserInfo(lookup->ids[i]);
+            if (single.ok() && crow::json::load(single.body)) {
+                std::lock_guard<std::mutex> lock(lookup->mutex);
+                lookup->found.emplace(lookup->ids[i], std::move(single.body));
+            }
+        }
+        std::lock_guard<std::mutex> lock(lookup->mutex);
+        --lookup->running;
+        lookup->done.notify_all();
+    };
+
+    size_t helpers = std::min(lookup->ids.size(), (size_t)std::max(1, options.maxConcurrent)) - 1;
+    for (size_t i = 0; i < helpers; ++i) {
+        {
+            std::lock_guard<std::mutex> lock(lookup->mutex);
+            ++lookup->running;
+        }
+        if (!hedges.tryRun(work)) {
+            std::lock_guard<std::mutex> lock(lookup->mutex);
+            --lookup->running;
+            break;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(lookup->mutex);
+        ++lookup->running;
+    }
+    work();
+
+    std::unique_lock<std::mutex> lock(lookup->mutex);
+    lookup->done.wait_until(lock, lookup->deadline, [&] { return lookup->running == 0; });
+    for (auto& [id, body] : lookup->found) result.emplace(id, std::move(body));
+    lock.unlock();
+
+    for (const auto& id : lookup->ids) {
+        if (result.count(id)) continue;
+        if (auto stale = userInfoCache.getStale(id, options.maxStale)) result.emplace(id, std::move(*stale));
+    }
+}
+
+AuthServiceResponse AuthServiceClient::updateFullName(const std::string& userId, const std::string& newName) {
+    crow::json::wvalue cmd;
+    cmd["user_id"] = userId;
+    cmd["new_name"] = newName;
+
+    auto res = send(Method::Patch, "/userservice/update_full_name", cmd.dump());
+    userInfoCache.erase(userId);
+    return res;
+}
+
+AuthServiceResponse AuthServiceClient::updateRoles(const std::string& userId, const crow::json::rvalue& roles) {
+    crow::json::wvalue cmd;
+    cmd["user_id"] = userId;
+    cmd["roles"] = roles;
+
+    auto res = send(Method::Patch, "/userservice/update_user_roles", cmd.dump());
+    rolesCache.erase(userId);
+    userInfoCache.erase(userId);
+    return res;
+}
+
+AuthServiceResponse AuthServiceClient::setBlockStatus(const std::string& userId, bool isBlocked) {
+    crow::json::wvalue cmd;
+    cmd["user_id"] = userId;
+    cmd["is_blocked"] = isBlocked;
+
+    auto res = send(Method::Post, "/userservice/set_block_status", cmd.dump());
+    blockStatusCache.erase(userId);
+    userInfoCache.erase(userId);
+    return res;
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include "crow.h"
+#include "cpr/cpr.h"
+#include "../cache/ttl_cache.h"
+#include "circuit_breaker.h"
+#include "../metrics/metrics.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Ответ auth-сервиса
+struct AuthServiceResponse {
+    long status = 0;
+    std::string body;
+
+    bool ok() const { return status == 200; }
+};
+
+// Настройки клиента auth-сервиса (переопределяются переменными окружения)
+struct AuthServiceOptions {
+    std::string baseUrl = "http://auth:8081";          // AUTH_BASE
+    std::chrono::milliseconds timeout{1500};           // AUTH_TIMEOUT_MS
+    std::chrono::milliseconds hedgeDelay{0};           // AUTH_HEDGE_MS, 0 - без дублирующих GET
+    int hedgeThreads = 16;                             // AUTH_HEDGE_THREADS, потоков для дублей GET и поштучных запросов
+    int maxConcurrent = 8;                             // AUTH_MAX_CONCURRENCY, на каждый метод
+    int failureThreshold = 5;                          // ошибок подряд до размыкания
+    std::chrono::milliseconds openTime{5000};          // сколько автомат остаётся разомкнутым
+    std::chrono::minutes maxStale{10};                 // насколько устаревший кеш можно отдать
+
+    static AuthServiceOptions fromEnv();
+};
+
+// Пул keep-alive сессий: соединение с auth-сервисом переиспользуется между запросами
+class SessionPool {
+public:
+    class Lease {
+    public:
+        Lease(SessionPool& pool, std::unique_ptr<cpr::Session> session) : pool(pool), session(std::move(session)) {}
+        ~Lease() { pool.release(std::move(session)); }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        cpr::Session* operator->() { return session.get(); }
+
+    private:
+        SessionPool& pool;
+        std::unique_ptr<cpr::Session> session;
+    };
+
+    SessionPool(size_t maxIdle, std::chrono::milliseconds timeout) : maxIdle(maxIdle), timeout(timeout) {}
+
+    Lease acquire();
+
+    // Для метрик: свободные сессии в пуле и занятые запросами
+    size_t idleCount();
+    int leasedCount() const { return leased.load(std::memory_order_relaxed); }
+
+private:
+    void release(std::unique_ptr<cpr::Session> session);
+
+    std::atomic<int> leased{0};
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<cpr::Session>> idle;
+    size_t maxIdle;
+    std::chrono::milliseconds timeout;
+};
+
+// Фиксированные потоки для дублированных GET и параллельных поштучных запросов, без очереди: задача запускается, только если
+// есть свободный поток, иначе вызывающий обходится без дубля. Деструктор дожидается задач.
+class HedgeExecutor {
+public:
+    explicit HedgeExecutor(size_t threads);
+    ~HedgeExecutor();
+
+    bool tryRun(std::function<void()> task);
+
+private:
+    void workerLoop();
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<std::function<void()>> tasks;
+    size_t idleWorkers = 0;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+};
+
+// Клиент auth-сервиса (/userservice/...) с кешем чтений.
+// Каждый метод защищён своим CircuitBreaker: при разомкнутом автомате или
+// исчерпанном лимите запрос сразу получает 503 (или устаревшие данные из кеша),
+// а не занимает поток Crow на время таймаута.
+class AuthServiceClient {
+public:
+    explicit AuthServiceClient(AuthServiceOptions options);
+
+    AuthServiceResponse getUserList();
+    AuthServiceResponse getUserInfo(const std::string& userId);
+    AuthServiceResponse getUserRoles(const std::string& userId);
+    AuthServiceResponse getBlockStatus(const std::string& userId);
+
+    // Информация о многих пользователях за один запрос: userId -> JSON из get_user_info.
+    // Ненайденные пользователи в результат не попадают.
+    std::unordered_map<std::string, std::string> getUsersInfo(const std::vector<std::string>& userIds);
+
+    AuthServiceResponse updateFullName(const std::string& userId, const std::string& newName);
+    AuthServiceResponse updateRoles(const std::string& userId, const crow::json::rvalue& roles);
+    AuthServiceResponse setBlockStatus(const std::string& userId, bool isBlocked);
+
+private:
+    enum class Method { Get, Post, Patch };
+
+    using ResponseCache = TtlCache<std::string, std::string>;
+
+    AuthServiceResponse send(Method method, const std::string& path, std::string body);
+    AuthServiceResponse perform(Method method, const std::string& path, const std::string& body);
+    AuthServiceResponse hedgedGet(CircuitBreaker& breaker, const std::string& path, std::string body);
+    AuthServiceResponse cachedGet(ResponseCache& cache, const std::string& path, const std::string& userId);
+    void lookupEach(std::vector<std::string> ids, std::unordered_map<std::string, std::string>& result);
+    void registerMetrics();
+
+    // Метрики одного метода auth-сервиса
+    struct EndpointMetrics {
+        Histogram* latency;
+        Counter* ok;
+        Counter* failed;
+        Counter* rejected;
+    };
+
+    AuthServiceOptions options;
+    SessionPool sessions;
+    std::unordered_map<std::string, std::unique_ptr<CircuitBreaker>> breakers;
+    std::unordered_map<std::string, EndpointMetrics> endpointMetrics;
+
+    ResponseCache userInfoCache;
+    ResponseCache rolesCache;
+    ResponseCache blockStatusCache;
+
+    // До какого момента (steady_clock) get_users_info считается неподдерживаемым
+    std::atomic<std::chrono::steady_clock::rep> batchUnsupportedUntil{0};
+
+    // Последним: задачи используют поля выше, деструктор дожидается их первым
+    HedgeExecutor hedges;
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Автомат защиты для одного метода внешнего сервиса.
+// Закрыт -> после failureThreshold ошибок подряд открыт на openTime ->
+// полуоткрыт (пропускает один пробный запрос) -> закрыт или снова открыт.
+// Дополнительно ограничивает число одновременных запросов.
+class CircuitBreaker {
+public:
+    enum class State { Closed, Open, HalfOpen };
+
+    CircuitBreaker(int failureThreshold, std::chrono::milliseconds openTime, int maxConcurrent)
+        : failureThreshold(failureThreshold), openTime(openTime), maxConcurrent(maxConcurrent) {}
+
+    // Занять слот под запрос (false - лимит одновременных запросов исчерпан)
+    bool tryAcquire() {
+        int current = inFlight.load(std::memory_order_relaxed);
+        while (current < maxConcurrent) {
+            if (inFlight.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void release() {
+        inFlight.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    // Можно ли отправлять запрос сейчас
+    bool allow() {
+        int64_t until = openUntil.load(std::memory_order_acquire);
+        if (until == 0) return true;
+        if (now() < until) return false;
+
+        bool expected = false;
+        return probeInFlight.compare_exchange_strong(expected, true, std::memory_order_acq_rel);
+    }
+
+    void onSuccess() {
+        consecutiveFailures.store(0, std::memory_order_relaxed);
+        openUntil.store(0, std::memory_order_release);
+        probeInFlight.store(false, std::memory_order_release);
+    }
+
+    void onFailure() {
+        if (probeInFlight.load(std::memory_order_acquire)) {
+            open();
+            return;
+        }
+        if (consecutiveFailures.fetch_add(1, std::memory_order_relaxed) + 1 >= failureThreshold) {
+            open();
+        }
+    }
+
+    State state() const {
+        int64_t until = openUntil.load(std::memory_order_acquire);
+        if (until == 0) return State::Closed;
+        return now() < until ? State::Open : State::HalfOpen;
+    }
+
+    int concurrency() const {
+        return inFlight.load(std::memory_order_relaxed);
+    }
+
+private:
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void open() {
+        openUntil.store(now() + openTime.count(), std::memory_order_release);
+        consecutiveFailures.store(0, std::memory_order_relaxed);
+        probeInFlight.store(false, std::memory_order_release);
+    }
+
+    const int failureThreshold;
+    const std::chrono::milliseconds openTime;
+    const int maxConcurrent;
+
+    std::atomic<int> consecutiveFailures{0};
+    std::atomic<int64_t> openUntil{0};
+    std::atomic<bool> probeInFlight{false};
+    std::atomic<int> inFlight{0};
+};
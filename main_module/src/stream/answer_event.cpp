@@ -0,0 +1,80 @@
+#include "answer_event.h"
+#include <charconv>
+
+namespace {
+
+constexpr const char* kEventFormatError = "Expected {\"s\": seq, \"a\": [[question_id, answer_index], ...]}";
+constexpr const char* kAnswerFormatError = "Each answer must be [question_id, answer_index]";
+
+void skipSpaces(const char*& p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r')) ++p;
+}
+
+bool consume(const char*& p, const char* end, char expected) {
+    skipSpaces(p, end);
+    if (p == end || *p != expected) return false;
+    ++p;
+    return true;
+}
+
+template <typename T>
+bool readInteger(const char*& p, const char* end, T& value) {
+    skipSpaces(p, end);
+    auto r = std::from_chars(p, end, value);
+    if (r.ec != std::errc()) return false;
+    p = r.ptr;
+    // 1.5, 1e3 - не целые
+    return p == end || (*p != '.' && *p != 'e' && *p != 'E');
+}
+
+// [[q, a], ...]
+const char* readAnswers(const char*& p, const char* end, std::vector<std::pair<int, int>>& answers) {
+    answers.clear();
+    if (!consume(p, end, '[')) return kEventFormatError;
+    if (consume(p, end, ']')) return nullptr;
+    while (true) {
+        std::pair<int, int> answer;
+        if (!consume(p, end, '[') || !readInteger(p, end, answer.first) || !consume(p, end, ',') ||
+            !readInteger(p, end, answer.second) || !consume(p, end, ']')) {
+            return kAnswerFormatError;
+        }
+        answers.push_back(answer);
+        if (consume(p, end, ']')) return nullptr;
+        if (!consume(p, end, ',')) return kEventFormatError;
+    }
+}
+
+} // namespace
+
+std::string parseAnswerEvent(std::string_view text, AnswerEvent& event) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    bool hasSeq = false;
+    bool hasAnswers = false;
+
+    if (!consume(p, end, '{')) return kEventFormatError;
+    if (!consume(p, end, '}')) {
+        while (true) {
+            if (!consume(p, end, '"') || end - p < 2 || p[1] != '"') return kEventFormatError;
+            char name = *p;
+            p += 2;
+            if (!consume(p, end, ':')) return kEventFormatError;
+
+            if (name == 's') {
+                if (!readInteger(p, end, event.seq)) return kEventFormatError;
+                hasSeq = true;
+            } else if (name == 'a') {
+                if (const char* error = readAnswers(p, end, event.answers)) return error;
+                hasAnswers = true;
+            } else {
+                return kEventFormatError;
+            }
+
+            if (consume(p, end, '}')) break;
+            if (!consume(p, end, ',')) return kEventFormatError;
+        }
+    }
+    skipSpaces(p, end);
+    if (p != end || !hasSeq || !hasAnswers) return kEventFormatError;
+    return "";
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Событие клиента потока ответов: {"s": <seq>, "a": [[question_id, answer_index], ...]}
+struct AnswerEvent {
+    long long seq = 0;
+    std::vector<std::pair<int, int>> answers;
+};
+
+// Разбор события без общего JSON-парсера: кадры приходят на каждый клик, формат фиксирован.
+// Ключи в любом порядке, числа - только целые. Пустая строка - успех, иначе текст ошибки для клиента
+std::string parseAnswerEvent(std::string_view text, AnswerEvent& event);
@@ -0,0 +1,126 @@
+#include "answer_stream.h"
+#include "../db/db.h"
+#include "../http/json_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+AnswerStreamOptions AnswerStreamOptions::fromEnv() {
+    AnswerStreamOptions options;
+    if (const char* value = std::getenv("ANSWER_STREAM_FLUSH_MS")) {
+        int millis = std::atoi(value);
+        if (millis > 0) options.flushMillis = millis;
+    }
+    return options;
+}
+
+AnswerStreamHub::AnswerStreamHub(std::string conninfo, AnswerStreamOptions options)
+    : conninfo(std::move(conninfo)), options(options), flusher(&AnswerStreamHub::flushLoop, this) {}
+
+AnswerStreamHub::~AnswerStreamHub() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (flusher.joinable()) flusher.join();
+}
+
+void AnswerStreamHub::open(crow::websocket::connection& conn, int attemptId, std::string userId, bool anyUser) {
+    auto session = std::make_shared<AnswerStreamSession>();
+    session->attemptId = attemptId;
+    session->userId = std::move(userId);
+    session->anyUser = anyUser;
+    session->conn = &conn;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    sessions[&conn] = std::move(session);
+    connections.add(1);
+}
+
+std::string AnswerStreamHub::receive(crow::websocket::connection& conn, const std::string& message) {
+    AnswerEvent event;
+    std::string error = parseAnswerEvent(message, event);
+    if (!error.empty()) return error;
+    const auto& answers = event.answers;
+    long long seq = event.seq;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = sessions.find(&conn);
+    if (it == sessions.end()) return "Stream is closed";
+    auto& session = *it->second;
+
+    size_t added = 0;
+    for (const auto& answer : answers) added += session.pending.count(answer.first) == 0;
+    if (session.pending.size() + added > options.maxPending) {
+        return "Too many unsaved answers, wait for an ack";
+    }
+    if (answers.empty()) return "";
+
+    if (session.pending.empty()) dirty.push_back(it->second);
+    for (const auto& [questionId, answerIndex] : answers) session.pending[questionId] = answerIndex;
+    session.pendingSeq = std::max(session.pendingSeq, seq);
+    events.inc(answers.size());
+    return "";
+}
+
+void AnswerStreamHub::close(crow::websocket::connection& conn) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = sessions.find(&conn);
+    if (it == sessions.end()) return;
+    it->second->conn = nullptr;
+    sessions.erase(it);
+    connections.add(-1);
+}
+
+std::vector<AnswerStreamHub::Flush> AnswerStreamHub::takePending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Flush> flushes;
+    flushes.reserve(dirty.size());
+    for (auto& session : dirty) {
+        flushes.push_back({session, std::move(session->pending), session->pendingSeq});
+        session->pending.clear();
+    }
+    dirty.clear();
+    return flushes;
+}
+
+void AnswerStreamHub::write(DB& db, const Flush& flush) {
+    JsonWriter batch;
+    batch.beginArray();
+    for (const auto& [questionId, answerIndex] : flush.answers) {
+        batch.beginObject().field("question_id", questionId).field("answer_index", answerIndex).endObject();
+    }
+    batch.endArray();
+
+    const auto& session = *flush.session;
+    std::string saved = db.saveAttemptAnswers(session.attemptId, session.userId, session.anyUser, batch.str());
+    writes.inc();
+
+    JsonWriter ack;
+    ack.beginObject().field("ack", flush.seq);
+    if (saved.empty()) {
+        ack.field("error", "Answers not saved: attempt completed or not found, or question is not in the attempt");
+    } else {
+        ack.key("answers").raw(saved);
+    }
+    ack.endObject();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (flush.session->conn) flush.session->conn->send_text(ack.str());
+}
+
+// Один поток на весь процесс: записи одного подключения идут строго по порядку
+void AnswerStreamHub::flushLoop() {
+    DB db(conninfo);
+    while (true) {
+        bool stop;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(options.flushMillis), [&] { return stopping; });
+            stop = stopping;
+        }
+        for (const auto& flush : takePending()) write(db, flush);
+        if (stop) break;
+    }
+}
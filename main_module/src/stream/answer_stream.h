@@ -0,0 +1,84 @@
+#pragma once
+#include "crow.h"
+#include "../metrics/metrics.h"
+#include "answer_event.h"
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class DB;
+
+// Поток ответов попытки по WebSocket: клиент авторизуется один раз при подключении
+// и шлёт короткие события, сервер копит их и пишет в базу пакетами.
+//
+// Событие клиента (текст): {"s": <seq>, "a": [[question_id, answer_index], ...]}
+// Подтверждение:           {"ack": <seq>, "answers": {<сохранённые ответы попытки>}}
+// Ошибка записи:           {"ack": <seq>, "error": "..."} - не сохранены ответы, пришедшие после
+//                          предыдущего ack (seq от него до этого ack); их нужно отправить снова
+// Ошибка разбора:          {"error": "..."}
+
+struct AnswerStreamOptions {
+    int flushMillis = 100;      // ANSWER_STREAM_FLUSH_MS, как часто накопленные ответы уходят в базу
+    size_t maxPending = 500;    // вопросов в ожидании на подключение, как у POST /attempts/<id>/answers:batch
+
+    static AnswerStreamOptions fromEnv();
+};
+
+struct AnswerStreamSession {
+    int attemptId = 0;
+    std::string userId;
+    bool anyUser = false;                           // право answer:update
+
+    // Поля ниже - под мьютексом хаба
+    crow::websocket::connection* conn = nullptr;    // nullptr после закрытия
+    std::map<int, int> pending;                     // вопрос -> ответ, последний выигрывает
+    long long pendingSeq = 0;
+};
+
+// Все подключения процесса и поток записи. Запись идёт через своё соединение с базой,
+// в базу уходит один UPDATE на подключение за интервал, сколько бы событий ни пришло.
+class AnswerStreamHub {
+public:
+    explicit AnswerStreamHub(std::string conninfo, AnswerStreamOptions options = AnswerStreamOptions::fromEnv());
+    ~AnswerStreamHub();
+
+    void open(crow::websocket::connection& conn, int attemptId, std::string userId, bool anyUser);
+    // Разбор события и постановка в очередь; "" или текст ошибки для клиента
+    std::string receive(crow::websocket::connection& conn, const std::string& message);
+    // Неотправленные ответы закрытого подключения всё равно записываются
+    void close(crow::websocket::connection& conn);
+
+private:
+    struct Flush {
+        std::shared_ptr<AnswerStreamSession> session;
+        std::map<int, int> answers;
+        long long seq;
+    };
+
+    void flushLoop();
+    std::vector<Flush> takePending();
+    void write(DB& db, const Flush& flush);
+
+    std::string conninfo;
+    AnswerStreamOptions options;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::unordered_map<crow::websocket::connection*, std::shared_ptr<AnswerStreamSession>> sessions;
+    std::vector<std::shared_ptr<AnswerStreamSession>> dirty;
+
+    Gauge& connections = MetricsRegistry::instance().gauge(
+        "core_answer_stream_connections", "Open answer stream WebSocket connections");
+    Counter& events = MetricsRegistry::instance().counter(
+        "core_answer_stream_answers_total", "Answers received over answer streams");
+    Counter& writes = MetricsRegistry::instance().counter(
+        "core_answer_stream_writes_total", "Coalesced answer stream writes to the database");
+
+    std::thread flusher;    // последним: стартует, когда остальные поля готовы
+};